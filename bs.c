@@ -13,10 +13,13 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/mman.h>
 #include "bs.h"
+#include "pagecopy.h"
 // =================================================================================================================================
 
 
@@ -29,11 +32,158 @@
 #define GB(n)      (MB(n) * 1024)
  
 #define DEFAULT_BACKING_STORE_SIZE GB(1)
-#define BLOCK_SIZE                 KB(4)
+#define DEFAULT_DEVICE_LATENCY     10000
+#define DEFAULT_DEVICE_TRANSFER    1000
+#define PAGE_SIZE                  KB(4)
+#define DEFAULT_BLOCK_SIZE         KB(4)
+#define MAX_DEVICES                8
+#define MAX_SLOTS                  (1u << 22)
+#define CLUSTER_CACHE_BLOCKS       4
+
+#define SEGMENT_BLOCKS             64
+#define LOG_RESERVE_SEGMENTS       2
+#define NO_BLOCK                   UINT_MAX
+
+// A backing device:  its own region, made of the page-sized slots [first_slot, first_slot + slot_count) of the global numbering.
+// Space is allocated in blocks of block_pages slots, handed out from a bump pointer and recycled through a free stack, with used
+// counting blocks.  An I/O of n pages costs latency + (n * transfer) ns.
+typedef struct {
+  void*         base;
+  void*         limit;
+  unsigned int  first_slot;
+  unsigned int  slot_count;
+  int           priority;
+  uint64_t      latency;
+  uint64_t      transfer;
+  unsigned int  next_free;
+  unsigned int* free_stack;
+  unsigned int  free_count;
+  unsigned int  used;
+  unsigned int  free_segments;
+  unsigned int  first_segment;
+  bs_device_stats_t stats;
+} device_t;
+
+static device_t     devices[MAX_DEVICES];
+static int          device_count   = 0;
+static unsigned int total_slots    = 0;
+
+// The allocation unit, and the block whose slots are currently being handed out one page at a time.  Block numbers given to
+// callers address individual page-sized slots:  the block times block_pages, plus the page's index within the block.
+static uint64_t     block_size     = DEFAULT_BLOCK_SIZE;
+static unsigned int block_pages    = 1;
+static unsigned int fill_block     = 0;
+static unsigned int fill_next      = 0;
+static uint8_t*     block_live     = NULL;
+
+// Under cluster reads, every read fetches its whole block, and the most recent blocks read are kept to serve their other pages.
+static bool         read_cluster   = false;
+static unsigned int cache_block[CLUSTER_CACHE_BLOCKS];
+static uint8_t*     cache_data     = NULL;
+static unsigned int cache_next     = 0;
+
+// The device at which the next stripe starts, so that devices of equal priority are used in turn.
+static int          stripe_next    = 0;
+
+// The simulated time spent on I/O if each request waits for the last, and as actually elapsed with parallel batches.
+static uint64_t     serial_time    = 0;
+static uint64_t     elapsed_time   = 0;
+
+// The log-structured layout.  Block numbers handed out to callers are then logical:  the index maps each to the physical block
+// holding its latest copy, and the owner table maps each physical block back to its logical block (0 when dead or free).  Writes
+// are gathered in the buffer of the open segment and reach the device one whole segment at a time.
+static bool          log_layout    = false;
+static unsigned int  log_capacity  = 0;
+static unsigned int  log_next_id   = 1;
+static unsigned int* log_free_ids  = NULL;
+static unsigned int  log_free_count = 0;
+static unsigned int* log_index     = NULL;
+static unsigned int* log_owner     = NULL;
+
+enum { SEGMENT_FREE, SEGMENT_OPEN, SEGMENT_USED };
+static unsigned int  segment_count = 0;
+static unsigned int* segment_first = NULL;
+static unsigned int* segment_live  = NULL;
+static uint8_t*      segment_state = NULL;
+static unsigned int  open_segment  = NO_BLOCK;
+static unsigned int  open_fill     = 0;
+static uint8_t*      open_buffer   = NULL;
+static bool          cleaning      = false;
+static bs_log_stats_t log_stats;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Map a new backing device and append its blocks to the global block numbering.
+ *
+ * \param size     The number of bytes on the device.
+ * \param priority The swap priority; higher priorities are filled first.
+ * \param latency  The simulated cost of issuing one I/O, in ns.
+ * \param transfer The simulated cost of moving one block, in ns.
+ */
+void
+add_device (uint64_t size, int priority, uint64_t latency, uint64_t transfer) {
+
+  assert(device_count < MAX_DEVICES);
+  device_t* dev    = &devices[device_count];
+  dev->base        = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  assert(dev->base != MAP_FAILED);
+  dev->limit       = (void*)((intptr_t)dev->base + size);
+  dev->first_slot = total_slots;
+  dev->slot_count = (size / block_size) * block_pages;
+  dev->priority    = priority;
+  dev->latency     = latency;
+  dev->transfer    = transfer;
+  dev->free_stack  = malloc(sizeof(unsigned int) * (dev->slot_count / block_pages));
+  assert(dev->free_stack != NULL);
+
+  // Block 0 is never handed out, so that a zero PTE always means "unmapped".
+  dev->next_free   = (total_slots == 0) ? 1 : 0;
+
+  total_slots    += dev->slot_count;
+  device_count    += 1;
+
+} // add_device ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Carve every device into segments and set up the tables of the log-structured layout.
+ */
+void
+log_init () {
+
+  for (int i = 0; i < device_count; i += 1) {
+    segment_count += devices[i].slot_count / SEGMENT_BLOCKS;
+  }
+  assert(segment_count > LOG_RESERVE_SEGMENTS + 1);
+  segment_first = malloc(sizeof(unsigned int) * segment_count);
+  segment_live  = calloc(segment_count, sizeof(unsigned int));
+  segment_state = calloc(segment_count, sizeof(uint8_t));
+  unsigned int segment = 0;
+  for (int i = 0; i < device_count; i += 1) {
+    devices[i].free_segments = devices[i].slot_count / SEGMENT_BLOCKS;
+    devices[i].first_segment = segment;
+    for (unsigned int j = 0; j < devices[i].free_segments; j += 1) {
+      segment_first[segment++] = devices[i].first_slot + (j * SEGMENT_BLOCKS);
+    }
+  }
 
-static void*        bs_base        = NULL;
-static void*        bs_limit       = NULL;
-static uint64_t     bs_size        = DEFAULT_BACKING_STORE_SIZE;
+  // Hold back enough segments that the cleaner always has somewhere to copy live blocks.
+  log_capacity   = (segment_count - LOG_RESERVE_SEGMENTS - 1) * SEGMENT_BLOCKS;
+  log_free_ids   = malloc(sizeof(unsigned int) * log_capacity);
+  log_index      = malloc(sizeof(unsigned int) * (log_capacity + 1));
+  log_owner      = calloc(total_slots, sizeof(unsigned int));
+  int aligned    = posix_memalign((void**)&open_buffer, PAGE_SIZE, SEGMENT_BLOCKS * PAGE_SIZE);
+  assert(segment_first != NULL && segment_live != NULL && segment_state != NULL && log_free_ids != NULL && log_index != NULL &&
+         log_owner != NULL && aligned == 0);
+  memset(log_index, 0xff, sizeof(unsigned int) * (log_capacity + 1));
+
+} // log_init ()
 // =================================================================================================================================
 
 
@@ -43,35 +193,101 @@ void
 bs_init () {
 
   // Only initialize if it hasn't already happened.
-  if (bs_base == NULL) {
+  if (device_count == 0) {
 
-    // Determine the backing store size, preferrably by environment variable, otherwise use the default.
-    char* bs_size_envvar = getenv("VMSIM_BS_SIZE");
-    if (bs_size_envvar != NULL) {
+    // Every device must hold whole blocks of the allocation unit.
+    char* block_size_envvar = getenv("VMSIM_BS_BLOCK_SIZE");
+    if (block_size_envvar != NULL) {
       errno = 0;
-      bs_size = strtoul(bs_size_envvar, NULL, 10);
-      assert(errno == 0);
+      block_size = strtoull(block_size_envvar, NULL, 10);
+      assert(errno == 0 && block_size >= PAGE_SIZE && block_size % PAGE_SIZE == 0);
+    }
+    block_pages = block_size / PAGE_SIZE;
+
+    // A list of devices, each given as <size>:<priority>:<latency>:<transfer>, takes precedence over a single device of a given
+    // size.
+    char* devices_envvar = getenv("VMSIM_BS_DEVICES");
+    if (devices_envvar != NULL) {
+      char* spec = devices_envvar;
+      while (*spec != '\0') {
+        errno = 0;
+        uint64_t size     = strtoull(spec, &spec, 10);
+        int      priority = 0;
+        uint64_t latency  = DEFAULT_DEVICE_LATENCY;
+        uint64_t transfer = DEFAULT_DEVICE_TRANSFER;
+        if (*spec == ':') priority = strtol(spec + 1, &spec, 10);
+        if (*spec == ':') latency  = strtoull(spec + 1, &spec, 10);
+        if (*spec == ':') transfer = strtoull(spec + 1, &spec, 10);
+        assert(errno == 0 && (*spec == ',' || *spec == '\0'));
+        add_device(size, priority, latency, transfer);
+        if (*spec == ',') spec += 1;
+      }
+    }
+
+    // Otherwise, determine the backing store size, preferrably by environment variable, otherwise use the default.
+    if (device_count == 0) {
+      uint64_t bs_size = DEFAULT_BACKING_STORE_SIZE;
+      char* bs_size_envvar = getenv("VMSIM_BS_SIZE");
+      if (bs_size_envvar != NULL) {
+        errno = 0;
+        bs_size = strtoul(bs_size_envvar, NULL, 10);
+        assert(errno == 0);
+      }
+      add_device(bs_size, 0, DEFAULT_DEVICE_LATENCY, DEFAULT_DEVICE_TRANSFER);
+    }
+
+    // A PTE keeps a block number in the 22 bits above its flags, so no slot may be numbered beyond them.
+    assert(total_slots <= MAX_SLOTS);
+
+    // Allocate whole blocks, counting how many of each block's slots are in use.
+    block_live = calloc(total_slots / block_pages, sizeof(uint8_t));
+    assert(block_live != NULL && block_pages <= UINT8_MAX);
+
+    // Choose the layout of blocks on the devices.
+    char* layout_envvar = getenv("VMSIM_BS_LAYOUT");
+    if (layout_envvar != NULL && strcmp(layout_envvar, "log") == 0) {
+      log_layout = true;
+      log_init();
+    }
+
+    // Optionally read whole blocks, keeping the latest few.  The log moves pages between blocks as it cleans, so this only
+    // applies to the direct layout.
+    char* cluster_envvar = getenv("VMSIM_BS_READ_CLUSTER");
+    if (cluster_envvar != NULL && strcmp(cluster_envvar, "0") != 0 && block_pages > 1 && !log_layout) {
+      read_cluster = true;
+      cache_data   = malloc(CLUSTER_CACHE_BLOCKS * block_size);
+      assert(cache_data != NULL);
+      memset(cache_block, 0, sizeof(cache_block));
     }
 
-    // Map the backing store space.
-    bs_base = mmap(NULL, bs_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    assert(bs_base != NULL);
-    bs_limit = (void*)((intptr_t)bs_base + bs_size);
-		   
   }
   
 }
 
 
 
+device_t*
+get_device (unsigned int block_number) {
+
+  for (int i = 0; i < device_count; i += 1) {
+    if (block_number - devices[i].first_slot < devices[i].slot_count) {
+      return &devices[i];
+    }
+  }
+  return NULL;
+
+}
+
+
+
 void*
-get_block_ptr (unsigned int block_number) {
+get_block_ptr (device_t* dev, unsigned int block_number) {
 
   // Calculate where requested block starts.
-  void* block_ptr = (void*)((intptr_t)bs_base + (block_number * BLOCK_SIZE));
+  void* block_ptr = (void*)((intptr_t)dev->base + ((uint64_t)(block_number - dev->first_slot) * PAGE_SIZE));
 
   // Don't allow a pointer that is off the end of the device.
-  if (block_ptr >= bs_limit) {
+  if (block_ptr >= dev->limit) {
     block_ptr = NULL;
   }
 
@@ -81,35 +297,615 @@ get_block_ptr (unsigned int block_number) {
 
 
 
+/**
+ * Account for one I/O operation on a device.
+ *
+ * \return the simulated cost of the operation, in ns.
+ */
+uint64_t
+charge (device_t* dev, unsigned int blocks, bool write) {
+
+  uint64_t cost = dev->latency + (blocks * dev->transfer);
+  if (write) {
+    dev->stats.writes    += blocks;
+    dev->stats.write_ops += 1;
+  } else {
+    dev->stats.reads     += blocks;
+    dev->stats.read_ops  += 1;
+  }
+  dev->stats.busy_time += cost;
+  serial_time          += cost;
+  return cost;
+
+}
+
+
+
 bool
-bs_read (vmsim_addr_t buffer, unsigned int block_number) {
+direct_has_room (device_t* dev) {
+
+  return dev->used < (dev->slot_count / block_pages) - (dev->first_slot == 0);
+
+}
+
+
+
+bool
+log_has_room (device_t* dev) {
+
+  return dev->free_segments > 0;
+
+}
+
+
+
+/**
+ * Choose the device on which to place new data:  the highest priority device with room, striping across devices of equal
+ * priority.
+ *
+ * \param  has_room Whether a device can take more data.
+ * \return the chosen device, or `NULL` if none has room.
+ */
+device_t*
+choose_device (bool (*has_room) (device_t*)) {
+
+  // Find the highest priority among devices that still have room.
+  device_t* best = NULL;
+  for (int i = 0; i < device_count; i += 1) {
+    device_t* dev = &devices[i];
+    if (has_room(dev) && (best == NULL || dev->priority > best->priority)) {
+      best = dev;
+    }
+  }
+  if (best == NULL) {
+    return NULL;
+  }
+
+  // Stripe across the devices of that priority, starting after the one used last.
+  for (int i = 0; i < device_count; i += 1) {
+    device_t* candidate = &devices[(stripe_next + i) % device_count];
+    if (candidate->priority == best->priority && has_room(candidate)) {
+      stripe_next = (candidate - devices + 1) % device_count;
+      return candidate;
+    }
+  }
+  return NULL;
+
+}
+
+
+
+/**
+ * Return a block, none of whose slots are in use, to its device.
+ */
+void
+release_block (unsigned int block) {
+
+  device_t* dev = get_device(block * block_pages);
+  dev->free_stack[dev->free_count++] = block - (dev->first_slot / block_pages);
+  dev->used -= 1;
+
+}
+
+
+
+unsigned int
+bs_alloc_block () {
+
+  // Under the log layout, only a logical number is needed; the space is found when the block is written.
+  if (log_layout) {
+    if (log_free_count > 0) {
+      return log_free_ids[--log_free_count];
+    }
+    return (log_next_id <= log_capacity) ? log_next_id++ : 0;
+  }
+
+  // Hand out the slots of the current block in order, taking a fresh block once it is exhausted.  The exhausted block is retired
+  // first, and returned to its device if none of its slots is still in use, so that the room it frees can take the fresh block.
+  if (fill_block == 0 || fill_next == block_pages) {
+    if (fill_block != 0 && block_live[fill_block] == 0) {
+      release_block(fill_block);
+    }
+    fill_block = 0;
+    device_t* dev = choose_device(direct_has_room);
+    if (dev == NULL) {
+      return 0;
+    }
+    unsigned int block = (dev->free_count > 0) ? dev->free_stack[--dev->free_count] : dev->next_free++;
+    dev->used += 1;
+    fill_block = (dev->first_slot / block_pages) + block;
+    fill_next  = 0;
+  }
+  block_live[fill_block] += 1;
+  return (fill_block * block_pages) + fill_next++;
+
+} // bs_alloc_block ()
+
+
+
+/**
+ * Mark the current copy of a logical block, if any, as dead.
+ */
+void
+log_kill (unsigned int block_number) {
+
+  unsigned int physical = log_index[block_number];
+  if (physical != NO_BLOCK) {
+    device_t* dev = get_device(physical);
+    log_owner[physical] = 0;
+    segment_live[dev->first_segment + ((physical - dev->first_slot) / SEGMENT_BLOCKS)] -= 1;
+    log_index[block_number] = NO_BLOCK;
+  }
+
+}
+
+
+
+void
+bs_free_block (unsigned int block_number) {
+
+  assert(block_number != 0);
+  if (log_layout) {
+    assert(block_number <= log_capacity);
+    log_kill(block_number);
+    log_free_ids[log_free_count++] = block_number;
+    return;
+  }
+
+  // A block is returned to its device once none of its slots are in use, unless slots are still being handed out from it.
+  unsigned int block = block_number / block_pages;
+  assert(get_device(block_number) != NULL && block_live[block] > 0);
+  block_live[block] -= 1;
+  if (block_live[block] == 0 && block != fill_block) {
+    release_block(block);
+  }
+
+} // bs_free_block ()
+
+
+
+/**
+ * Write the full buffer of the open segment to its device as one sequential I/O.
+ */
+void
+flush_segment () {
+
+  unsigned int first = segment_first[open_segment];
+  device_t*    dev   = get_device(first);
+  uint8_t*     segment = get_block_ptr(dev, first);
+  for (unsigned int i = 0; i < SEGMENT_BLOCKS; i += 1) {
+    pc_stream(segment + (i * PAGE_SIZE), open_buffer + (i * PAGE_SIZE));
+  }
+  elapsed_time += charge(dev, SEGMENT_BLOCKS, true);
+  log_stats.device_writes       += SEGMENT_BLOCKS;
+  log_stats.segment_writes      += 1;
+  segment_state[open_segment]    = SEGMENT_USED;
+  open_segment                   = NO_BLOCK;
+
+}
+
+
+
+void log_append (unsigned int block_number, const void* data);
+
+/**
+ * Reclaim segments by copying their live blocks to the head of the log, choosing the segments with the fewest live blocks first,
+ * until the reserve of free segments is restored.
+ */
+void
+clean_segments () {
+
+  cleaning = true;
+  while (true) {
+
+    // Count the free segments afresh on every pass, since the blocks the cleaner moves may open and fill segments of their own.
+    unsigned int free_segments = 0;
+    for (int i = 0; i < device_count; i += 1) {
+      free_segments += devices[i].free_segments;
+    }
+    if (free_segments >= LOG_RESERVE_SEGMENTS) {
+      break;
+    }
+
+    // Pick the used segment with the fewest live blocks.
+    unsigned int victim = NO_BLOCK;
+    for (unsigned int segment = 0; segment < segment_count; segment += 1) {
+      if (segment_state[segment] == SEGMENT_USED && (victim == NO_BLOCK || segment_live[segment] < segment_live[victim])) {
+        victim = segment;
+      }
+    }
+    if (victim == NO_BLOCK || segment_live[victim] == SEGMENT_BLOCKS) {
+      break;
+    }
+
+    // Read the whole segment and re-append whatever is still live.
+    unsigned int first = segment_first[victim];
+    device_t*    dev   = get_device(first);
+    uint8_t*     data  = get_block_ptr(dev, first);
+    uint64_t     cost  = charge(dev, SEGMENT_BLOCKS, false);
+    elapsed_time            += cost;
+    log_stats.cleaner_time  += cost;
+    for (unsigned int i = 0; i < SEGMENT_BLOCKS; i += 1) {
+      unsigned int block_number = log_owner[first + i];
+      if (block_number != 0) {
+        log_append(block_number, data + (i * PAGE_SIZE));
+        log_stats.cleaner_moved += 1;
+      }
+    }
+    assert(segment_live[victim] == 0);
+    segment_state[victim]  = SEGMENT_FREE;
+    dev->free_segments    += 1;
+    log_stats.cleaner_runs += 1;
+
+  }
+  cleaning = false;
+
+}
+
+
+
+/**
+ * Open a free segment as the new head of the log, cleaning first if free segments are running low.  The cleaner may itself open
+ * a segment for the blocks it moves, which then stays the head.
+ */
+void
+open_new_segment () {
+
+  if (!cleaning) {
+    clean_segments();
+    if (open_segment != NO_BLOCK) {
+      return;
+    }
+  }
+
+  device_t* dev = choose_device(log_has_room);
+  assert(dev != NULL);
+  for (unsigned int segment = 0; segment < segment_count; segment += 1) {
+    if (segment_state[segment] == SEGMENT_FREE && get_device(segment_first[segment]) == dev) {
+      segment_state[segment] = SEGMENT_OPEN;
+      dev->free_segments    -= 1;
+      open_segment           = segment;
+      open_fill              = 0;
+      return;
+    }
+  }
+  assert(false);
+
+}
+
+
+
+/**
+ * Claim the next slot at the head of the log for the latest copy of a logical block.  The caller fills the slot, and then calls
+ * `log_advance()` before anything else touches the log.
+ *
+ * \return where in the open segment's buffer to put the block's data.
+ */
+void*
+log_claim (unsigned int block_number) {
+
+  log_kill(block_number);
+  if (open_segment == NO_BLOCK) {
+    open_new_segment();
+  }
+
+  unsigned int physical = segment_first[open_segment] + open_fill;
+  log_owner[physical]         = block_number;
+  log_index[block_number]     = physical;
+  segment_live[open_segment] += 1;
+  return open_buffer + (open_fill * PAGE_SIZE);
+
+}
+
+
+
+/**
+ * Move the head of the log past the slot just filled, writing the open segment out once it is full.
+ */
+void
+log_advance () {
+
+  open_fill += 1;
+  if (open_fill == SEGMENT_BLOCKS) {
+    flush_segment();
+  }
+
+}
+
+
+
+/**
+ * Append the latest copy of a logical block at the head of the log.
+ */
+void
+log_append (unsigned int block_number, const void* data) {
+
+  pc_stream(log_claim(block_number), data);
+  log_advance();
+
+}
+
+
+
+/**
+ * Keep a cached copy of a block in step with a page just written to it.
+ */
+void
+update_cluster_cache (unsigned int block_number, const void* data) {
+
+  if (read_cluster) {
+    for (unsigned int i = 0; i < CLUSTER_CACHE_BLOCKS; i += 1) {
+      if (cache_block[i] == block_number / block_pages) {
+        memcpy(cache_data + (i * block_size) + ((block_number % block_pages) * PAGE_SIZE), data, PAGE_SIZE);
+      }
+    }
+  }
+
+}
+
+
+
+/**
+ * Copy a page's data to its destination:  host memory if given, otherwise real memory.
+ */
+static inline void
+deliver (vmsim_addr_t buffer, void* host, void* data) {
+
+  if (host != NULL) {
+    pc_copy(host, data);
+  } else {
+    vmsim_write_real(data, buffer, PAGE_SIZE);
+  }
+
+}
+
+
+
+/**
+ * Copy one block from its device into real memory, or into host memory if `host` is not `NULL`.
+ *
+ * \param  cost Where to store the simulated cost of the read, in ns.
+ * \return the device read, `NULL` if no device I/O was needed, or `(device_t*)-1` if the block number is not valid.
+ */
+device_t*
+read_block (vmsim_addr_t buffer, void* host, unsigned int block_number, uint64_t* cost) {
+
+  *cost = 0;
+  unsigned int physical = block_number;
+  if (log_layout) {
+    if (block_number == 0 || block_number > log_capacity || log_index[block_number] == NO_BLOCK) {
+      return (device_t*)-1;
+    }
+    physical = log_index[block_number];
+
+    // Blocks still in the open segment's buffer need no device I/O.
+    if (open_segment != NO_BLOCK && physical - segment_first[open_segment] < open_fill) {
+      deliver(buffer, host, open_buffer + ((physical - segment_first[open_segment]) * PAGE_SIZE));
+      return NULL;
+    }
+  }
 
   // Get the block pointer, and check if its valid.
-  void* block_ptr = get_block_ptr(block_number);
+  device_t* dev = get_device(physical);
+  if (dev == NULL) {
+    return (device_t*)-1;
+  }
+  void* block_ptr = get_block_ptr(dev, physical);
   if (block_ptr == NULL) {
-    return false;
+    return (device_t*)-1;
   }
 
-  // Copy the block into real memory.
-  vmsim_write_real(block_ptr, buffer, BLOCK_SIZE);
+  if (!read_cluster) {
+    deliver(buffer, host, block_ptr);
+    *cost = charge(dev, 1, false);
+    return dev;
+  }
+
+  // Serve the page from a cached block if possible, otherwise read its whole block into the cache.
+  unsigned int block = physical / block_pages;
+  unsigned int page  = physical % block_pages;
+  for (unsigned int i = 0; i < CLUSTER_CACHE_BLOCKS; i += 1) {
+    if (cache_block[i] == block) {
+      deliver(buffer, host, cache_data + (i * block_size) + (page * PAGE_SIZE));
+      dev->stats.cluster_hits += 1;
+      return NULL;
+    }
+  }
+  unsigned int i = cache_next;
+  cache_next     = (cache_next + 1) % CLUSTER_CACHE_BLOCKS;
+  cache_block[i] = block;
+  memcpy(cache_data + (i * block_size), get_block_ptr(dev, block * block_pages), block_size);
+  deliver(buffer, host, cache_data + (i * block_size) + (page * PAGE_SIZE));
+  *cost = charge(dev, block_pages, false);
+  return dev;
+
+}
+
+
+
+bool
+bs_read (vmsim_addr_t buffer, unsigned int block_number) {
+
+  uint64_t  cost;
+  device_t* dev = read_block(buffer, NULL, block_number, &cost);
+  if (dev == (device_t*)-1) {
+    return false;
+  }
+  elapsed_time += cost;
   return true;
   
 } // bs_read ()
 
 
 
+/**
+ * Read a batch of blocks into real or host memory, with each device working through its share of the batch on its own, so that
+ * the batch takes as long as the busiest device.
+ */
+bool
+read_batch (const vmsim_addr_t* buffers, void* const* pages, const unsigned int* block_numbers, size_t count) {
+
+  uint64_t device_time[MAX_DEVICES] = { 0 };
+  bool     success                  = true;
+  for (size_t i = 0; i < count; i += 1) {
+    uint64_t  cost;
+    device_t* dev = read_block((buffers != NULL) ? buffers[i] : 0, (pages != NULL) ? pages[i] : NULL, block_numbers[i], &cost);
+    if (dev == (device_t*)-1) {
+      success = false;
+    } else if (dev != NULL) {
+      device_time[dev - devices] += cost;
+    }
+  }
+
+  uint64_t batch_time = 0;
+  for (int i = 0; i < device_count; i += 1) {
+    if (device_time[i] > batch_time) {
+      batch_time = device_time[i];
+    }
+  }
+  elapsed_time += batch_time;
+  return success;
+
+}
+
+
+
+bool
+bs_readv (const vmsim_addr_t* buffers, const unsigned int* block_numbers, size_t count) {
+
+  return read_batch(buffers, NULL, block_numbers, count);
+
+} // bs_readv ()
+
+
+
+bool
+bs_read_batch (void* const* pages, const unsigned int* block_numbers, size_t count) {
+
+  return read_batch(NULL, pages, block_numbers, count);
+
+} // bs_read_batch ()
+
+
+
 bool
 bs_write (vmsim_addr_t buffer, unsigned int block_number) {
 
+  // Under the log layout, every write goes to the head of the log, streamed straight into the open segment.
+  if (log_layout) {
+    if (block_number == 0 || block_number > log_capacity) {
+      return false;
+    }
+    vmsim_stream_real(log_claim(block_number), buffer);
+    log_advance();
+    log_stats.user_writes += 1;
+    return true;
+  }
+
   // Get the block pointer, and check if its valid.
-  void* block_ptr = get_block_ptr(block_number);
+  device_t* dev = get_device(block_number);
+  if (dev == NULL) {
+    return false;
+  }
+  void* block_ptr = get_block_ptr(dev, block_number);
   if (block_ptr == NULL) {
     return false;
   }
 
-  // Copy the block into real memory.
-  vmsim_read_real(block_ptr, buffer, BLOCK_SIZE);
+  // Copy the block from real memory, bypassing the cache, since it will not be read again until it is faulted back in.
+  vmsim_stream_real(block_ptr, buffer);
+  update_cluster_cache(block_number, block_ptr);
+  elapsed_time += charge(dev, 1, true);
   return true;
   
 } // bs_write ()
+
+
+
+bool
+bs_write_batch (const void* const* pages, const unsigned int* block_numbers, size_t count) {
+
+  // Under the log layout, the batch simply joins the log in order.
+  if (log_layout) {
+    for (size_t i = 0; i < count; i += 1) {
+      if (block_numbers[i] == 0 || block_numbers[i] > log_capacity) {
+        return false;
+      }
+      log_append(block_numbers[i], pages[i]);
+    }
+    log_stats.user_writes += count;
+    return true;
+  }
+
+  // Otherwise, each run of consecutive blocks on one device becomes a single operation, and the devices work in parallel.
+  uint64_t device_time[MAX_DEVICES] = { 0 };
+  size_t   i                        = 0;
+  while (i < count) {
+    device_t* dev = get_device(block_numbers[i]);
+    if (dev == NULL) {
+      return false;
+    }
+    size_t run = 1;
+    while (i + run < count && block_numbers[i + run] == block_numbers[i] + run && get_device(block_numbers[i + run]) == dev) {
+      run += 1;
+    }
+    for (size_t j = i; j < i + run; j += 1) {
+      pc_stream(get_block_ptr(dev, block_numbers[j]), pages[j]);
+      update_cluster_cache(block_numbers[j], pages[j]);
+    }
+    device_time[dev - devices] += charge(dev, run, true);
+    i += run;
+  }
+
+  uint64_t batch_time = 0;
+  for (int d = 0; d < device_count; d += 1) {
+    if (device_time[d] > batch_time) {
+      batch_time = device_time[d];
+    }
+  }
+  elapsed_time += batch_time;
+  return true;
+
+} // bs_write_batch ()
+
+
+
+int
+bs_device_count () {
+
+  return device_count;
+
+} // bs_device_count ()
+
+
+
+void
+bs_get_device_stats (int device, bs_device_stats_t* stats) {
+
+  assert(device >= 0 && device < device_count);
+  *stats            = devices[device].stats;
+  stats->used       = devices[device].used;
+  stats->priority   = devices[device].priority;
+  stats->blocks     = devices[device].slot_count / block_pages;
+
+} // bs_get_device_stats ()
+
+
+
+void
+bs_get_io_time (uint64_t* serial, uint64_t* elapsed) {
+
+  *serial  = serial_time;
+  *elapsed = elapsed_time;
+
+} // bs_get_io_time ()
+
+
+
+void
+bs_get_log_stats (bs_log_stats_t* stats) {
+
+  *stats = log_stats;
+
+} // bs_get_log_stats ()
 // =================================================================================================================================
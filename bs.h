@@ -28,14 +28,72 @@
 
 
 
+// =================================================================================================================================
+// TYPES
+
+/** Counters describing one backing device. */
+typedef struct {
+  uint64_t     reads;     /**< Pages read from the device. */
+  uint64_t     writes;    /**< Pages written to the device. */
+  uint64_t     read_ops;  /**< Read operations issued to the device. */
+  uint64_t     write_ops; /**< Write operations issued to the device. */
+  uint64_t     cluster_hits; /**< Page reads served from a block already read whole. */
+  uint64_t     busy_time; /**< The simulated time the device spent on I/O, in ns. */
+  unsigned int used;      /**< Blocks currently allocated on the device. */
+  unsigned int blocks;    /**< The capacity of the device, in blocks. */
+  int          priority;  /**< The swap priority of the device. */
+} bs_device_stats_t;
+
+/**
+ * Counters describing the log-structured layout.  The write amplification is `device_writes / user_writes`.
+ */
+typedef struct {
+  uint64_t user_writes;    /**< Blocks written by callers. */
+  uint64_t device_writes;  /**< Blocks written to the devices, including those copied by the cleaner. */
+  uint64_t segment_writes; /**< Whole segments written to the devices. */
+  uint64_t cleaner_runs;   /**< Segments reclaimed by the cleaner. */
+  uint64_t cleaner_moved;  /**< Live blocks copied by the cleaner. */
+  uint64_t cleaner_time;   /**< The simulated time spent reading segments to clean them, in ns. */
+} bs_log_stats_t;
+// =================================================================================================================================
+
+
+
 // =================================================================================================================================
 // FUNCTIONS
 
 /**
- * \brief  Initialize the simulated backing store device.
+ * \brief  Initialize the simulated backing store devices.
+ *
+ * `VMSIM_BS_DEVICES` may list the devices as comma-separated `<size>:<priority>:<latency>:<transfer>` entries, with sizes in bytes,
+ * the per-operation latency and per-block transfer time in ns, and trailing fields optional.  Otherwise, a single device of
+ * `VMSIM_BS_SIZE` bytes is used.  The blocks of all devices share one numbering, in the order the devices are listed.
+ *
+ * Space is allocated in blocks of `VMSIM_BS_BLOCK_SIZE` bytes, a multiple of the page size.  The block numbers used by the other
+ * functions address one page-sized slot within a block:  the block times the pages per block, plus the page's index.  Consecutive
+ * allocations fill one block before moving on.  Setting `VMSIM_BS_READ_CLUSTER` makes every read fetch its whole block, keeping
+ * the last few blocks read to serve their other pages without further I/O.
+ *
+ * Setting `VMSIM_BS_LAYOUT` to `log` selects a log-structured layout:  block numbers become logical, every write is appended to
+ * the open segment and reaches a device only as a whole sequential segment, and a cleaner compacts the segments with the most
+ * dead blocks when free segments run low.
  */
 void bs_init  ();
 
+/**
+ * \brief  Allocate a free block.
+ * \return the number of the allocated block, or 0 if every device is full.
+ *
+ * Devices with a higher priority are filled first.  Blocks are striped across the devices of equal priority, one at a time.
+ */
+unsigned int bs_alloc_block ();
+
+/**
+ * \brief  Release a block allocated with `bs_alloc_block()`.
+ * \param  block_number The block to release.
+ */
+void bs_free_block (unsigned int block_number);
+
 /**
  * \brief  Read data from a block.
  * \param  buffer       The _real_ address of a space into which to copy the block's data.
@@ -44,6 +102,17 @@ void bs_init  ();
  */
 bool bs_read  (vmsim_addr_t buffer, unsigned int block_number);
 
+/**
+ * \brief  Read a batch of blocks, issued in parallel across the devices that hold them.
+ * \param  buffers       The _real_ addresses into which to copy each block's data.
+ * \param  block_numbers The block numbers to read.
+ * \param  count         The number of blocks in the batch.
+ * \return whether every read was successful.
+ *
+ * The batch costs as much simulated time as the busiest device spends on its share of it.
+ */
+bool bs_readv (const vmsim_addr_t* buffers, const unsigned int* block_numbers, size_t count);
+
 /**
  * \brief  Write data to a block.
  * \param  buffer       The _real_ address of a space from which to copy the block's data.
@@ -51,6 +120,52 @@ bool bs_read  (vmsim_addr_t buffer, unsigned int block_number);
  * \return whether the operation was successful.
  */
 bool bs_write (vmsim_addr_t buffer, unsigned int block_number);
+
+/**
+ * \brief  Read a batch of blocks into host memory, issued in parallel across the devices that hold them.
+ * \param  pages         Pointers to the spaces into which to copy each block's data.
+ * \param  block_numbers The block numbers to read.
+ * \param  count         The number of blocks in the batch.
+ * \return whether every read was successful.
+ */
+bool bs_read_batch (void* const* pages, const unsigned int* block_numbers, size_t count);
+
+/**
+ * \brief  Write a batch of blocks from host memory.
+ * \param  pages         Pointers to the data of each block.
+ * \param  block_numbers The block numbers to write.
+ * \param  count         The number of blocks in the batch.
+ * \return whether every write was successful.
+ *
+ * Runs of consecutive block numbers on one device are written as a single operation, and the devices work in parallel, so
+ * batches sorted by block number are cheapest.
+ */
+bool bs_write_batch (const void* const* pages, const unsigned int* block_numbers, size_t count);
+
+/**
+ * \return the number of backing devices.
+ */
+int  bs_device_count ();
+
+/**
+ * \brief  Report the activity of one backing device.
+ * \param  device The index of the device, in the order the devices were listed.
+ * \param  stats  A space into which to copy the device's counters.
+ */
+void bs_get_device_stats (int device, bs_device_stats_t* stats);
+
+/**
+ * \brief  Report the simulated time spent on backing store I/O.
+ * \param  serial  Where to store the time that the I/O would have taken had each request waited for the previous one, in ns.
+ * \param  elapsed Where to store the time actually elapsed, with batched requests overlapping across devices, in ns.
+ */
+void bs_get_io_time (uint64_t* serial, uint64_t* elapsed);
+
+/**
+ * \brief  Report the activity of the log-structured layout.
+ * \param  stats A space into which to copy the counters, which stay zero under the direct layout.
+ */
+void bs_get_log_stats (bs_log_stats_t* stats);
 // =================================================================================================================================
 
 
@@ -0,0 +1,299 @@
+// =================================================================================================================================
+/**
+ * cachemodel.c
+ *
+ * Estimate the cost of simulated accesses by following them through set-associative models of the TLBs and data caches.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cachemodel.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+#define PAGE_SHIFT             12
+#define DEFAULT_LINE_SIZE      64
+#define DEFAULT_MEMORY_CYCLES  200
+#define MAX_WALK_ENTRIES       4
+
+#define POLICY_LRU             0
+#define POLICY_FIFO            1
+#define POLICY_RANDOM          2
+
+// One level of cache or TLB.  Each set holds `ways` tags, each one more than the key it holds so that 0 marks an empty way, and
+// the stamps by which the policy orders them:  the last use under LRU, the fill under FIFO.
+typedef struct {
+  bool      present;
+  uint64_t  sets;
+  uint64_t  ways;
+  uint64_t  latency;
+  int       policy;
+  uint64_t* tags;
+  uint64_t* stamps;
+} level_t;
+
+static bool      enabled       = false;
+static bool      ready         = false;
+static cm_walk_t walk          = NULL;
+static unsigned  line_shift    = 0;
+static uint64_t  memory_cycles = DEFAULT_MEMORY_CYCLES;
+static level_t   caches[CM_CACHE_LEVELS];
+static level_t   tlbs[CM_TLB_LEVELS];
+static uint64_t  use_clock     = 0;
+static uint32_t  random_state  = 2463534242;
+
+static cm_stats_t stats;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Configure one level from its environment variable, or from the default description.
+ *
+ * \param level         The level to configure.
+ * \param name          The name of the environment variable.
+ * \param default_value The description to use if the variable is not set.
+ * \param unit          The number of bytes covered by one entry:  the line size for caches, 1 for TLBs, whose sizes are in entries.
+ */
+void
+configure_level (level_t* level, const char* name, const char* default_value, uint64_t unit) {
+
+  const char* spec = getenv(name);
+  if (spec == NULL) {
+    spec = default_value;
+  }
+
+  char*    end;
+  uint64_t size    = strtoull(spec, &end, 10);
+  assert(*end == ':');
+  level->ways      = strtoull(end + 1, &end, 10);
+  assert(*end == ':');
+  level->latency   = strtoull(end + 1, &end, 10);
+  assert(*end == ':' || *end == '\0');
+  level->policy    = POLICY_LRU;
+  if (*end == ':') {
+    const char* policy = end + 1;
+    level->policy = (strcmp(policy, "fifo") == 0)   ? POLICY_FIFO   :
+                    (strcmp(policy, "random") == 0) ? POLICY_RANDOM : POLICY_LRU;
+    assert(level->policy != POLICY_LRU || strcmp(policy, "lru") == 0);
+  }
+
+  level->present = (size != 0);
+  if (level->present) {
+    assert(level->ways > 0 && size >= unit * level->ways);
+    level->sets   = size / (unit * level->ways);
+    level->tags   = calloc(level->sets * level->ways, sizeof(uint64_t));
+    level->stamps = calloc(level->sets * level->ways, sizeof(uint64_t));
+    assert(level->tags != NULL && level->stamps != NULL);
+  }
+
+} // configure_level ()
+
+
+
+bool
+cm_init (cm_walk_t walk_function) {
+
+  // Only initialize if it hasn't already happened.
+  if (!ready) {
+
+    char* enabled_envvar = getenv("VMSIM_CACHE_MODEL");
+    enabled = (enabled_envvar != NULL && enabled_envvar[0] != '0');
+    walk    = walk_function;
+    if (enabled) {
+      char*    line_envvar = getenv("VMSIM_CACHE_LINE");
+      uint64_t line_size   = (line_envvar == NULL) ? DEFAULT_LINE_SIZE : strtoull(line_envvar, NULL, 10);
+      assert(line_size > 0 && (line_size & (line_size - 1)) == 0 && line_size <= (1 << PAGE_SHIFT));
+      while (((uint64_t)1 << line_shift) < line_size) {
+        line_shift += 1;
+      }
+      char* memory_envvar = getenv("VMSIM_MEMORY_CYCLES");
+      if (memory_envvar != NULL) {
+        memory_cycles = strtoull(memory_envvar, NULL, 10);
+      }
+      configure_level(&caches[CM_L1],    "VMSIM_CACHE_L1",  "32768:8:4",     line_size);
+      configure_level(&caches[CM_L2],    "VMSIM_CACHE_L2",  "1048576:16:14", line_size);
+      configure_level(&caches[CM_LLC],   "VMSIM_CACHE_LLC", "8388608:16:42", line_size);
+      configure_level(&tlbs[CM_TLB_L1],  "VMSIM_TLB_L1",    "64:4:1",        1);
+      configure_level(&tlbs[CM_TLB_L2],  "VMSIM_TLB_L2",    "1536:12:8",     1);
+    }
+    ready = true;
+
+  }
+  return enabled;
+
+} // cm_init ()
+
+
+
+/**
+ * Look up a key in one level, filling it in on a miss in place of the way chosen by the level's policy.
+ *
+ * \return whether the key was present.
+ */
+bool
+probe (level_t* level, cm_level_stats_t* level_stats, uint64_t key) {
+
+  uint64_t* tags   = &level->tags[(key % level->sets) * level->ways];
+  uint64_t* stamps = &level->stamps[(key % level->sets) * level->ways];
+  uint64_t  victim = 0;
+  use_clock += 1;
+
+  // Empty ways carry stamp 0, so the oldest way is an empty one if there is any.
+  for (uint64_t way = 0; way < level->ways; way += 1) {
+    if (tags[way] == key + 1) {
+      if (level->policy == POLICY_LRU) {
+        stamps[way] = use_clock;
+      }
+      level_stats->hits += 1;
+      return true;
+    }
+    if (stamps[way] < stamps[victim]) {
+      victim = way;
+    }
+  }
+
+  level_stats->misses += 1;
+  if (level->policy == POLICY_RANDOM && stamps[victim] != 0) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    victim        = random_state % level->ways;
+  }
+  tags[victim]   = key + 1;
+  stamps[victim] = use_clock;
+  return false;
+
+} // probe ()
+
+
+
+/**
+ * Read one line through the data caches.
+ *
+ * \return the cycles taken:  the latency of the first level holding the line, or the memory latency.
+ */
+uint64_t
+read_line (uint64_t line) {
+
+  for (int i = 0; i < CM_CACHE_LEVELS; i += 1) {
+    if (caches[i].present && probe(&caches[i], &stats.caches[i], line)) {
+      return caches[i].latency;
+    }
+  }
+  return memory_cycles;
+
+} // read_line ()
+
+
+
+/**
+ * Translate a page through the TLBs, walking the page table if they all miss.
+ *
+ * \return the cycles taken:  the latency of the first TLB holding the translation, or the cost of the walk.
+ */
+uint64_t
+translate (int space, vmsim_addr_t sim_addr) {
+
+  uint64_t key = ((uint64_t)space << 32) | (sim_addr >> PAGE_SHIFT);
+  for (int i = 0; i < CM_TLB_LEVELS; i += 1) {
+    if (tlbs[i].present && probe(&tlbs[i], &stats.tlbs[i], key)) {
+      return tlbs[i].latency;
+    }
+  }
+
+  // The walk reads each level's entry in turn, so their costs add up.
+  vmsim_addr_t pte_addrs[MAX_WALK_ENTRIES];
+  int          count  = walk(sim_addr, pte_addrs);
+  uint64_t     cycles = 0;
+  assert(count <= MAX_WALK_ENTRIES);
+  for (int i = 0; i < count; i += 1) {
+    cycles += read_line(pte_addrs[i] >> line_shift);
+  }
+  stats.walks       += 1;
+  stats.walk_cycles += cycles;
+  return cycles;
+
+} // translate ()
+
+
+
+void
+cm_access (int space, vmsim_addr_t sim_addr, vmsim_addr_t real_addr, size_t size) {
+
+  // The lines of one access are fetched in parallel, so the access costs as much as its slowest line.
+  uint64_t cycles = translate(space, sim_addr);
+  uint64_t slowest = 0;
+  uint64_t last    = ((uint64_t)real_addr + (size > 0 ? size - 1 : 0)) >> line_shift;
+  for (uint64_t line = real_addr >> line_shift; line <= last; line += 1) {
+    uint64_t line_cycles = read_line(line);
+    if (line_cycles > slowest) {
+      slowest = line_cycles;
+    }
+  }
+  stats.accesses += 1;
+  stats.cycles   += cycles + slowest;
+
+} // cm_access ()
+
+
+
+void
+cm_invalidate (int space, vmsim_addr_t sim_addr) {
+
+  if (!enabled) {
+    return;
+  }
+  uint64_t key = ((uint64_t)space << 32) | (sim_addr >> PAGE_SHIFT);
+  for (int i = 0; i < CM_TLB_LEVELS; i += 1) {
+    level_t* level = &tlbs[i];
+    if (!level->present) {
+      continue;
+    }
+    uint64_t* tags   = &level->tags[(key % level->sets) * level->ways];
+    uint64_t* stamps = &level->stamps[(key % level->sets) * level->ways];
+    for (uint64_t way = 0; way < level->ways; way += 1) {
+      if (tags[way] == key + 1) {
+        tags[way]            = 0;
+        stamps[way]          = 0;
+        stats.invalidations += 1;
+      }
+    }
+  }
+
+} // cm_invalidate ()
+
+
+
+uint64_t
+cm_page_colors () {
+
+  if (!enabled || !caches[CM_LLC].present) {
+    return 0;
+  }
+  uint64_t colors = (caches[CM_LLC].sets << line_shift) >> PAGE_SHIFT;
+  return (colors > 0) ? colors : 1;
+
+} // cm_page_colors ()
+
+
+
+void
+cm_get_stats (cm_stats_t* copy) {
+
+  *copy = stats;
+  copy->cycles_per_access = (stats.accesses == 0) ? 0.0 : (double)stats.cycles / stats.accesses;
+
+} // cm_get_stats ()
@@ -0,0 +1,127 @@
+// =================================================================================================================================
+/**
+ * \file   cachemodel.h
+ * \brief  The interface for the model of the CPU's caches and TLBs.
+ *
+ * A simple module that is part of the `vmsim` library.  It follows the stream of simulated accesses through a hierarchy of
+ * set-associative TLBs and data caches, and estimates the cycles that each access would take.  Each access is first translated:  a
+ * hit in the L1 or L2 TLB costs that TLB's latency, and a miss in both walks the page table, whose entries are themselves read
+ * through the data caches.  Then every cache line that the access touches is looked up in the L1, L2 and last-level caches in turn,
+ * costing the latency of the first level that holds it, or the memory latency if none does; a missing line is filled into every
+ * level.  The TLBs are tagged with the address space and the caches with the _real_ address, so a page that moves to another frame
+ * finds its lines cold.
+ *
+ * The model is enabled by setting `VMSIM_CACHE_MODEL`.  Each level is described by a variable of the form
+ * `size:ways:latency[:policy]`, where the size is in bytes for caches and in entries for TLBs, the latency is in cycles, and the
+ * replacement policy is one of `lru` (the default), `fifo` or `random`; a size of 0 removes the level.  The variables, with their
+ * defaults, are `VMSIM_CACHE_L1` (`32768:8:4`), `VMSIM_CACHE_L2` (`1048576:16:14`), `VMSIM_CACHE_LLC` (`8388608:16:42`),
+ * `VMSIM_TLB_L1` (`64:4:1`) and `VMSIM_TLB_L2` (`1536:12:8`).  `VMSIM_CACHE_LINE` gives the line size (64) and
+ * `VMSIM_MEMORY_CYCLES` the memory latency (200).
+ */
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_CACHEMODEL_H)
+#define _CACHEMODEL_H
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// TYPES
+
+/** The data cache levels, in lookup order. */
+#define CM_L1    0
+#define CM_L2    1
+#define CM_LLC   2
+#define CM_CACHE_LEVELS 3
+
+/** The TLB levels, in lookup order. */
+#define CM_TLB_L1 0
+#define CM_TLB_L2 1
+#define CM_TLB_LEVELS 2
+
+/** A function that finds the _real_ addresses of the page table entries translating a _simulated_ address, returning how many. */
+typedef int (*cm_walk_t) (vmsim_addr_t sim_addr, vmsim_addr_t* pte_addrs);
+
+/** Counters describing one level of cache or TLB. */
+typedef struct {
+  uint64_t hits;   /**< Lookups that found their line or translation at this level. */
+  uint64_t misses; /**< Lookups that went on to the next level. */
+} cm_level_stats_t;
+
+/** Counters describing the modelled hierarchy. */
+typedef struct {
+  uint64_t         accesses;                 /**< Simulated reads and writes modelled. */
+  uint64_t         cycles;                   /**< The estimated cycles taken by those accesses. */
+  uint64_t         walks;                    /**< Page table walks, after misses in every TLB. */
+  uint64_t         walk_cycles;              /**< The cycles spent in those walks. */
+  uint64_t         invalidations;            /**< TLB entries dropped because their page moved or left real memory. */
+  double           cycles_per_access;        /**< The average cost of an access. */
+  cm_level_stats_t caches[CM_CACHE_LEVELS];  /**< Data cache lookups by level, including those made by page table walks. */
+  cm_level_stats_t tlbs[CM_TLB_LEVELS];      /**< TLB lookups by level. */
+} cm_stats_t;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// FUNCTIONS
+
+/**
+ * \brief  Initialize the model, reading its configuration from the environment.
+ * \param  walk The function with which to find the page table entries read by a walk.
+ * \return whether the model is enabled.
+ */
+bool     cm_init        (cm_walk_t walk);
+
+/**
+ * \brief  Model one simulated access.
+ * \param  space     The address space making the access, which tags its translations.
+ * \param  sim_addr  The _simulated_ address accessed.
+ * \param  real_addr The _real_ address to which it translates.
+ * \param  size      The number of bytes accessed.
+ */
+void     cm_access      (int space, vmsim_addr_t sim_addr, vmsim_addr_t real_addr, size_t size);
+
+/**
+ * \brief  Drop every TLB entry for a page, whose translation has changed or gone away.
+ * \param  space    The address space of the page.
+ * \param  sim_addr The _simulated_ address of the page.
+ */
+void     cm_invalidate  (int space, vmsim_addr_t sim_addr);
+
+/**
+ * \brief  Report the number of page colors:  the page-sized slices of one way of the last-level cache, which real pages of
+ *         different colors can never share.
+ * \return the number of colors, or 0 if the model is disabled or has no last-level cache.
+ */
+uint64_t cm_page_colors ();
+
+/**
+ * \brief  Report the activity of the model.
+ * \param  stats A space into which to copy the counters.
+ */
+void     cm_get_stats   (cm_stats_t* stats);
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+#endif // _CACHEMODEL_H
+// =================================================================================================================================
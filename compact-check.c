@@ -0,0 +1,96 @@
+// =================================================================================================================================
+/**
+ * \file   compact-check.c
+ * \brief  Map buffers into contiguous runs of frames while a hot working set keeps the slow tier busy, and check that every run is
+ *         built and no data is lost.  Use the `vmsim` library for the pages.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+/** The number of bytes in a page. */
+#define PAGESIZE  4096
+
+/** Real memory:  the page table area, then 128 frames, of which the top 64 form the slow tier. */
+#define REAL_SIZE "4722688"
+#define SLOW_SIZE "262144"
+
+/** The working set, which overflows the fast tier, the pages of each contiguous buffer, and the buffers mapped. */
+#define PAGES     100
+#define RUN_PAGES 16
+#define BUFFERS   40
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Touch every page of the working set, checking the value that each holds, so that slow pages run hot.
+ * \param base The simulated address of the working set.
+ */
+void
+touch_working_set (vmsim_addr_t base) {
+
+  for (uint32_t page = 0; page < PAGES; page += 1) {
+    uint32_t value;
+    vmsim_read(&value, base + (page * PAGESIZE), sizeof(value));
+    assert(value == page);
+  }
+
+} // touch_working_set ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Map buffer after buffer into contiguous frames between sweeps of the working set.
+ * \return the exit code for the process, where 0 indicates success.
+ */
+int
+main () {
+
+  setenv("VMSIM_REAL_MEM_SIZE", REAL_SIZE, 1);
+  setenv("VMSIM_SLOW_MEM_SIZE", SLOW_SIZE, 1);
+  vmsim_addr_t base = vmsim_alloc(PAGES * PAGESIZE);
+  for (uint32_t page = 0; page < PAGES; page += 1) {
+    vmsim_write(&page, base + (page * PAGESIZE), sizeof(page));
+  }
+
+  for (uint32_t i = 0; i < BUFFERS; i += 1) {
+    touch_working_set(base);
+    touch_working_set(base);
+    vmsim_addr_t buffer = vmsim_alloc(RUN_PAGES * PAGESIZE);
+    size_t       mapped = vmsim_prefault(buffer, RUN_PAGES * PAGESIZE, VMSIM_PREFAULT_CONTIGUOUS);
+    assert(mapped == RUN_PAGES);
+    for (uint32_t page = 0; page < RUN_PAGES; page += 1) {
+      uint32_t value = i;
+      vmsim_write(&value, buffer + (page * PAGESIZE), sizeof(value));
+    }
+    vmsim_free(buffer);
+  }
+  touch_working_set(base);
+
+  vmsim_compaction_stats_t stats;
+  vmsim_get_compaction_stats(&stats);
+  assert(stats.failures == 0 && stats.contiguous_pages == BUFFERS * RUN_PAGES);
+  printf("compact-check: %lu runs, %lu pages moved, %lu pushed out\n", stats.runs, stats.migrations, stats.evictions);
+  return 0;
+
+} // main ()
+// =================================================================================================================================
@@ -0,0 +1,91 @@
+// =================================================================================================================================
+/**
+ * \file   copy-check.c
+ * \brief  Copy a buffer asynchronously while another address space runs and drives the copy engine, with frames split into bins so
+ *         small that a copy can pin a whole one, and check that the copy lands intact.  Use the `vmsim` library for the pages.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+/** The number of bytes in a page. */
+#define PAGESIZE   4096
+
+/** Real memory of 64 frames, on 4 nodes of 16 colors, so that each bin holds a single frame. */
+#define REAL_SIZE  "4460544"
+#define NODES      "4"
+#define COLORS     "16"
+
+/** The pages copied, which with their copy overflow real memory, and the pages that the other space works on. */
+#define PAGES      48
+#define WORK_PAGES 24
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Start a copy in the first space, then run the second, whose accesses carry the copy along, and check the copied pages.
+ * \return the exit code for the process, where 0 indicates success.
+ */
+int
+main () {
+
+  setenv("VMSIM_REAL_MEM_SIZE", REAL_SIZE, 1);
+  setenv("VMSIM_NUMA_NODES",    NODES,     1);
+  setenv("VMSIM_PAGE_COLORING", "virtual", 1);
+  setenv("VMSIM_PAGE_COLORS",   COLORS,    1);
+  vmsim_addr_t src = vmsim_alloc(PAGES * PAGESIZE);
+  vmsim_addr_t dst = vmsim_alloc(PAGES * PAGESIZE);
+  for (uint32_t page = 0; page < PAGES; page += 1) {
+    vmsim_write(&page, src + (page * PAGESIZE), sizeof(page));
+  }
+
+  int worker = vmsim_space_create(1);
+  vmsim_space_switch(worker);
+  vmsim_addr_t work = vmsim_alloc(WORK_PAGES * PAGESIZE);
+  vmsim_space_switch(0);
+  vmsim_space_stats_t before;
+  vmsim_get_space_stats(0, &before);
+  vmsim_copy_t copy = vmsim_memcpy_async(dst, src, PAGES * PAGESIZE);
+
+  // The worker's accesses advance the copy, whose faults belong to the first space alone.
+  vmsim_space_switch(worker);
+  for (uint32_t i = 0; i < 20 * PAGES; i += 1) {
+    vmsim_write(&i, work + ((i % WORK_PAGES) * PAGESIZE), sizeof(i));
+  }
+  assert(vmsim_space_current() == worker);
+  vmsim_space_switch(0);
+  vmsim_space_stats_t after;
+  vmsim_get_space_stats(0, &after);
+  vmsim_memcpy_wait(copy);
+  assert(after.accesses == before.accesses && after.faults > before.faults);
+
+  for (uint32_t page = 0; page < PAGES; page += 1) {
+    uint32_t value;
+    vmsim_read(&value, dst + (page * PAGESIZE), sizeof(value));
+    assert(value == page);
+  }
+  vmsim_copy_stats_t stats;
+  vmsim_get_copy_stats(&stats);
+  assert(stats.completed == 1 && stats.bytes == PAGES * PAGESIZE);
+  printf("copy-check: %lu chunks, %lu pages pinned, %lu stalls\n", stats.chunks, stats.pinned_pages, stats.stalls);
+  return 0;
+
+} // main ()
+// =================================================================================================================================
@@ -0,0 +1,150 @@
+// =================================================================================================================================
+/**
+ * dma.c
+ *
+ * Carry out batches of copies on a helper thread, as a DMA engine would, so that data movement overlaps the caller's work.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dma.h"
+#include "pagecopy.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+#define PAGESIZE          4096
+#define IS_PAGE_ALIGNED(p) (((uintptr_t)(p) & (PAGESIZE - 1)) == 0)
+
+// One queued batch, with its own copy of the pieces.
+typedef struct batch_s {
+  uint64_t        ticket;
+  size_t          count;
+  struct batch_s* next;
+  dma_piece_t     pieces[];
+} batch_t;
+
+// The queue of batches, oldest first, and the tickets issued and completed, all guarded by `lock`.  The helper signals `done` after
+// each batch and waits on `queued` while the queue is empty.
+static pthread_mutex_t lock       = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  queued     = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  done       = PTHREAD_COND_INITIALIZER;
+static batch_t*        head       = NULL;
+static batch_t*        tail       = NULL;
+static uint64_t        issued     = 0;
+static uint64_t        completed  = 0;
+static bool            running    = false;
+static pthread_t       helper;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * The helper thread:  take each batch in turn, make its copies without holding the lock, and publish its completion.
+ */
+static void*
+run_helper (void* unused) {
+
+  (void)unused;
+  pthread_mutex_lock(&lock);
+  while (true) {
+
+    while (head == NULL) {
+      pthread_cond_wait(&queued, &lock);
+    }
+    batch_t* batch = head;
+    pthread_mutex_unlock(&lock);
+
+    for (size_t i = 0; i < batch->count; i += 1) {
+      dma_piece_t* piece = &batch->pieces[i];
+      if (piece->size == PAGESIZE && IS_PAGE_ALIGNED(piece->dst) && IS_PAGE_ALIGNED(piece->src)) {
+        pc_stream(piece->dst, piece->src);
+      } else {
+        memcpy(piece->dst, piece->src, piece->size);
+      }
+    }
+
+    pthread_mutex_lock(&lock);
+    head = batch->next;
+    if (head == NULL) {
+      tail = NULL;
+    }
+    completed = batch->ticket;
+    free(batch);
+    pthread_cond_broadcast(&done);
+
+  }
+  return NULL;
+
+} // run_helper ()
+
+
+
+uint64_t
+dma_submit (const dma_piece_t* pieces, size_t count) {
+
+  batch_t* batch = malloc(sizeof(batch_t) + (sizeof(dma_piece_t) * count));
+  assert(batch != NULL);
+  memcpy(batch->pieces, pieces, sizeof(dma_piece_t) * count);
+  batch->count = count;
+  batch->next  = NULL;
+
+  pthread_mutex_lock(&lock);
+  if (!running) {
+    int started = pthread_create(&helper, NULL, run_helper, NULL);
+    assert(started == 0);
+    pthread_detach(helper);
+    running = true;
+  }
+  issued       += 1;
+  batch->ticket = issued;
+  uint64_t ticket = issued;
+  if (tail == NULL) {
+    head = batch;
+  } else {
+    tail->next = batch;
+  }
+  tail = batch;
+  pthread_cond_signal(&queued);
+  pthread_mutex_unlock(&lock);
+  return ticket;
+
+} // dma_submit ()
+
+
+
+bool
+dma_complete (uint64_t ticket) {
+
+  pthread_mutex_lock(&lock);
+  bool complete = (completed >= ticket);
+  pthread_mutex_unlock(&lock);
+  return complete;
+
+} // dma_complete ()
+
+
+
+void
+dma_wait (uint64_t ticket) {
+
+  pthread_mutex_lock(&lock);
+  while (completed < ticket) {
+    pthread_cond_wait(&done, &lock);
+  }
+  pthread_mutex_unlock(&lock);
+
+} // dma_wait ()
+// =================================================================================================================================
@@ -0,0 +1,77 @@
+// =================================================================================================================================
+/**
+ * \file   dma.h
+ * \brief  The interface for the copy engine that moves data between frames in the background.
+ *
+ * A simple module that is part of the `vmsim` library.  Like a DMA engine, it takes batches of copies between host memory ranges
+ * and carries them out on a helper thread of its own, in the order they were submitted, while the caller goes on with other work.
+ * It knows nothing of pages or mappings:  the caller must keep every range in place, and untouched by anything else, until the
+ * batch is complete.  Whole aligned pages are copied with non-temporal stores, since data that a device moves is not in the CPU's
+ * caches.
+ */
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_DMA_H)
+#define _DMA_H
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// TYPES
+
+/** One copy in a batch. */
+typedef struct {
+  void*       dst;  /**< Where to copy the data. */
+  const void* src;  /**< The data to copy. */
+  size_t      size; /**< The number of bytes to copy. */
+} dma_piece_t;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// FUNCTIONS
+
+/**
+ * \brief  Queue a batch of copies for the helper thread, starting the thread if it is not yet running.
+ * \param  pieces The copies, which are taken before this function returns.
+ * \param  count  The number of copies.
+ * \return a ticket with which to check for the batch's completion.  Tickets increase with each batch.
+ */
+uint64_t dma_submit   (const dma_piece_t* pieces, size_t count);
+
+/**
+ * \brief  Report whether a batch is complete.
+ * \param  ticket The batch's ticket.
+ * \return whether every copy in the batch, and in every earlier batch, has been made.
+ */
+bool     dma_complete (uint64_t ticket);
+
+/**
+ * \brief  Block until a batch is complete.
+ * \param  ticket The batch's ticket.
+ */
+void     dma_wait     (uint64_t ticket);
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+#endif // _DMA_H
+// =================================================================================================================================
@@ -0,0 +1,86 @@
+// =================================================================================================================================
+/**
+ * \file   log-check.c
+ * \brief  Overwrite pages at random through a small log-structured backing store, so that the segment cleaner runs again and
+ *         again, and check that every page keeps its latest data.  Use the `vmsim` library for the pages.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bs.h"
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+/** The number of bytes in a page. */
+#define PAGESIZE  4096
+
+/** Real memory of 64 frames, and a backing store of 16 segments of 64 blocks. */
+#define REAL_SIZE "4460544"
+#define BS_SIZE   "4194304"
+
+/** The live pages, far more than real memory holds, and the random accesses made to them. */
+#define PAGES     250
+#define ACCESSES  200000
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Read or overwrite random pages, checking each read against a shadow copy of the values written.
+ * \return the exit code for the process, where 0 indicates success.
+ */
+int
+main () {
+
+  setenv("VMSIM_REAL_MEM_SIZE", REAL_SIZE, 1);
+  setenv("VMSIM_BS_SIZE",       BS_SIZE,   1);
+  setenv("VMSIM_BS_LAYOUT",     "log",     1);
+  vmsim_addr_t base = vmsim_alloc(PAGES * PAGESIZE);
+
+  static uint32_t shadow[PAGES];
+  for (uint32_t page = 0; page < PAGES; page += 1) {
+    shadow[page] = page;
+    vmsim_write(&shadow[page], base + (page * PAGESIZE), sizeof(uint32_t));
+  }
+
+  srandom(171);
+  for (uint32_t i = 0; i < ACCESSES; i += 1) {
+    uint32_t     page = random() % PAGES;
+    vmsim_addr_t addr = base + (page * PAGESIZE);
+    if (random() % 2 == 0) {
+      uint32_t value;
+      vmsim_read(&value, addr, sizeof(value));
+      assert(value == shadow[page]);
+    } else {
+      shadow[page] = random();
+      vmsim_write(&shadow[page], addr, sizeof(uint32_t));
+    }
+  }
+  for (uint32_t page = 0; page < PAGES; page += 1) {
+    uint32_t value;
+    vmsim_read(&value, base + (page * PAGESIZE), sizeof(value));
+    assert(value == shadow[page]);
+  }
+
+  bs_log_stats_t stats;
+  bs_get_log_stats(&stats);
+  assert(stats.cleaner_runs > 0 && stats.device_writes >= stats.user_writes);
+  printf("log-check: %lu segments cleaned, %lu blocks moved\n", stats.cleaner_runs, stats.cleaner_moved);
+  return 0;
+
+} // main ()
+// =================================================================================================================================
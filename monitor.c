@@ -0,0 +1,399 @@
+// =================================================================================================================================
+/**
+ * monitor.c
+ *
+ * Estimate the access frequency of adaptively sized regions of each simulated address space by sampling reference bits.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdlib.h>
+#include "monitor.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+#define PAGE_SHIFT                12
+#define DEFAULT_SAMPLE_INTERVAL   1000
+#define DEFAULT_AGGREGATE_SAMPLES 20
+#define DEFAULT_MIN_REGIONS       10
+#define DEFAULT_MAX_REGIONS       1000
+#define DEFAULT_HISTORY           4096
+
+// One region, in page numbers:  its bounds, the page to be sampled next, and its access counts for this and the previous interval.
+typedef struct {
+  uint32_t     start;
+  uint32_t     end;
+  uint32_t     sample;
+  unsigned int accesses;
+  unsigned int last_accesses;
+  unsigned int age;
+} region_t;
+
+// One address space's regions, in address order, a second array into which to rebuild them, and its progress through its own
+// sampling and aggregation intervals, which count only its own accesses.
+typedef struct {
+  int          space;
+  region_t*    regions;
+  region_t*    scratch;
+  unsigned int region_count;
+  uint64_t     ticks;
+  uint64_t     interval_samples;
+  uint64_t     aggregations;
+} monitored_t;
+
+static bool          enabled           = false;
+static bool          ready             = false;
+static mon_harvest_t harvest           = NULL;
+static uint64_t      sample_interval   = DEFAULT_SAMPLE_INTERVAL;
+static uint64_t      aggregate_samples = DEFAULT_AGGREGATE_SAMPLES;
+static unsigned int  min_regions       = DEFAULT_MIN_REGIONS;
+static unsigned int  max_regions       = DEFAULT_MAX_REGIONS;
+
+// The regions of each space, whose arrays are allocated when the space is first sampled.
+static monitored_t*  monitored         = NULL;
+static int           space_count       = 0;
+static uint32_t      random_state      = 2463534242;
+
+// The time series, as a ring of records.
+static mon_record_t* history           = NULL;
+static size_t        history_size      = DEFAULT_HISTORY;
+static size_t        history_first     = 0;
+static size_t        history_count     = 0;
+
+static mon_stats_t   stats;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \return the value of a numeric environment variable, or the default if it is not set.
+ */
+uint64_t
+mon_getenv (const char* name, uint64_t default_value) {
+
+  char* value = getenv(name);
+  return (value == NULL) ? default_value : strtoull(value, NULL, 10);
+
+}
+
+
+
+bool
+mon_init (mon_harvest_t harvest_function, int spaces) {
+
+  // Only initialize if it hasn't already happened.
+  if (!ready) {
+
+    char* enabled_envvar = getenv("VMSIM_MONITOR");
+    enabled           = (enabled_envvar != NULL && enabled_envvar[0] != '0');
+    harvest           = harvest_function;
+    sample_interval   = mon_getenv("VMSIM_MONITOR_SAMPLE",      sample_interval);
+    aggregate_samples = mon_getenv("VMSIM_MONITOR_AGGREGATE",   aggregate_samples);
+    min_regions       = mon_getenv("VMSIM_MONITOR_MIN_REGIONS", min_regions);
+    max_regions       = mon_getenv("VMSIM_MONITOR_MAX_REGIONS", max_regions);
+    history_size      = mon_getenv("VMSIM_MONITOR_HISTORY",     history_size);
+    assert(sample_interval > 0 && aggregate_samples > 0 && min_regions > 0 && min_regions <= max_regions && history_size > 0);
+    if (enabled) {
+      space_count = spaces;
+      monitored   = calloc(space_count, sizeof(monitored_t));
+      history     = malloc(sizeof(mon_record_t) * history_size);
+      assert(monitored != NULL && history != NULL);
+      for (int space = 0; space < space_count; space += 1) {
+        monitored[space].space = space;
+      }
+    }
+    ready = true;
+
+  }
+  return enabled;
+
+}
+
+
+
+/**
+ * \return a pseudo-random number in [0, bound).
+ */
+uint32_t
+random_below (uint32_t bound) {
+
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state % bound;
+
+}
+
+
+
+/**
+ * Choose the page that a region will sample next, and clear its reference bit so that the sample sees only later accesses.
+ */
+void
+prepare_sample (monitored_t* m, region_t* region) {
+
+  region->sample = region->start + random_below(region->end - region->start);
+  harvest(m->space, (vmsim_addr_t)region->sample << PAGE_SHIFT);
+  stats.checks += 1;
+
+}
+
+
+
+/**
+ * Divide a space's monitored range, from page 1 up to the limit, evenly into the minimum number of regions.
+ */
+void
+create_regions (monitored_t* m, uint32_t limit) {
+
+  if (m->regions == NULL) {
+    m->regions = malloc(sizeof(region_t) * max_regions);
+    m->scratch = malloc(sizeof(region_t) * max_regions);
+    assert(m->regions != NULL && m->scratch != NULL);
+  }
+  uint32_t pages  = limit - 1;
+  m->region_count = (pages < min_regions) ? pages : min_regions;
+  for (unsigned int i = 0; i < m->region_count; i += 1) {
+    region_t* region      = &m->regions[i];
+    region->start         = 1 + (uint32_t)(((uint64_t)pages * i) / m->region_count);
+    region->end           = 1 + (uint32_t)(((uint64_t)pages * (i + 1)) / m->region_count);
+    region->accesses      = 0;
+    region->last_accesses = 0;
+    region->age           = 0;
+    prepare_sample(m, region);
+  }
+
+}
+
+
+
+/**
+ * Cover any newly allocated space, with a new region if there is room for one and otherwise by extending the last region.
+ */
+void
+extend_regions (monitored_t* m, uint32_t limit) {
+
+  region_t* last = &m->regions[m->region_count - 1];
+  if (limit <= last->end) {
+    return;
+  }
+  if (m->region_count < max_regions) {
+    region_t* region      = &m->regions[m->region_count++];
+    region->start         = last->end;
+    region->end           = limit;
+    region->accesses      = 0;
+    region->last_accesses = 0;
+    region->age           = 0;
+    prepare_sample(m, region);
+  } else {
+    last->end = limit;
+  }
+
+}
+
+
+
+/**
+ * Append a record to the time series, overwriting the oldest if it is full.
+ */
+void
+append_record (const monitored_t* m, const region_t* region) {
+
+  if (history_count == history_size) {
+    history_first  = (history_first + 1) % history_size;
+    history_count -= 1;
+    stats.dropped += 1;
+  }
+  mon_record_t* record = &history[(history_first + history_count) % history_size];
+  record->space        = m->space;
+  record->aggregation  = m->aggregations;
+  record->start        = (vmsim_addr_t)region->start << PAGE_SHIFT;
+  record->end          = (vmsim_addr_t)region->end << PAGE_SHIFT;
+  record->accesses     = region->accesses;
+  record->age          = region->age;
+  history_count       += 1;
+
+}
+
+
+
+/**
+ * Age each region, resetting the age of those whose frequency changed markedly, and merge adjacent regions whose frequencies are
+ * within the threshold of each other, weighting the merged counts by size.
+ */
+void
+merge_regions (monitored_t* m, unsigned int threshold) {
+
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < m->region_count; i += 1) {
+
+    region_t* region = &m->regions[i];
+    unsigned int change = (region->accesses > region->last_accesses ?
+                           region->accesses - region->last_accesses :
+                           region->last_accesses - region->accesses);
+    region->age = (change > threshold) ? 0 : region->age + 1;
+
+    region_t* previous = (count > 0) ? &m->scratch[count - 1] : NULL;
+    unsigned int difference = (previous == NULL ? 0 :
+                               previous->accesses > region->accesses ?
+                               previous->accesses - region->accesses :
+                               region->accesses - previous->accesses);
+    if (previous != NULL && difference <= threshold && count + (m->region_count - i) > min_regions) {
+      uint64_t previous_size = previous->end - previous->start;
+      uint64_t region_size   = region->end - region->start;
+      uint64_t size          = previous_size + region_size;
+      previous->accesses      = ((previous->accesses * previous_size) + (region->accesses * region_size)) / size;
+      previous->last_accesses = ((previous->last_accesses * previous_size) + (region->last_accesses * region_size)) / size;
+      previous->age           = ((previous->age * previous_size) + (region->age * region_size)) / size;
+      previous->end           = region->end;
+      stats.merges           += 1;
+    } else {
+      m->scratch[count++] = *region;
+    }
+
+  }
+
+  region_t* swap  = m->regions;
+  m->regions      = m->scratch;
+  m->scratch      = swap;
+  m->region_count = count;
+
+}
+
+
+
+/**
+ * Split each region in two at a random point between a tenth and nine tenths of its size, while there is room for more regions, so
+ * that the next interval can find finer boundaries.
+ */
+void
+split_regions (monitored_t* m) {
+
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < m->region_count; i += 1) {
+
+    region_t region = m->regions[i];
+    uint32_t size   = region.end - region.start;
+    if (size >= 2 && count + (m->region_count - i) < max_regions) {
+      uint32_t split = region.start + ((size * (1 + random_below(9))) / 10);
+      if (split == region.start) {
+        split += 1;
+      }
+      m->scratch[count]     = region;
+      m->scratch[count].end = split;
+      count                += 1;
+      region.start          = split;
+      stats.splits         += 1;
+    }
+    m->scratch[count++] = region;
+
+  }
+
+  region_t* swap  = m->regions;
+  m->regions      = m->scratch;
+  m->scratch      = swap;
+  m->region_count = count;
+
+}
+
+
+
+/**
+ * Close one space's aggregation interval:  merge similar regions, record every region, and split them for the next interval.
+ */
+void
+aggregate (monitored_t* m, uint32_t limit) {
+
+  unsigned int old_count = m->region_count;
+  merge_regions(m, (aggregate_samples / 10 > 0) ? aggregate_samples / 10 : 1);
+  for (unsigned int i = 0; i < m->region_count; i += 1) {
+    append_record(m, &m->regions[i]);
+    m->regions[i].last_accesses = m->regions[i].accesses;
+    m->regions[i].accesses      = 0;
+  }
+  m->aggregations    += 1;
+  stats.aggregations += 1;
+
+  split_regions(m);
+  extend_regions(m, limit);
+  for (unsigned int i = 0; i < m->region_count; i += 1) {
+    prepare_sample(m, &m->regions[i]);
+  }
+  stats.regions = stats.regions - old_count + m->region_count;
+
+}
+
+
+
+void
+mon_tick (int space, vmsim_addr_t limit) {
+
+  assert(space >= 0 && space < space_count);
+  monitored_t* m = &monitored[space];
+  m->ticks += 1;
+  if (m->ticks < sample_interval) {
+    return;
+  }
+  m->ticks = 0;
+
+  // The monitored range runs from page 1 up to the end of the space's allocated space.
+  uint32_t limit_page = ((uint64_t)limit + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT;
+  if (m->region_count == 0) {
+    if (limit_page > 1) {
+      create_regions(m, limit_page);
+      stats.regions += m->region_count;
+    }
+    return;
+  }
+
+  // Check each region's sampled page, then choose the next one.
+  for (unsigned int i = 0; i < m->region_count; i += 1) {
+    if (harvest(space, (vmsim_addr_t)m->regions[i].sample << PAGE_SHIFT)) {
+      m->regions[i].accesses += 1;
+    }
+    stats.checks += 1;
+    prepare_sample(m, &m->regions[i]);
+  }
+  stats.samples += 1;
+
+  m->interval_samples += 1;
+  if (m->interval_samples == aggregate_samples) {
+    m->interval_samples = 0;
+    aggregate(m, limit_page);
+  }
+
+} // mon_tick ()
+
+
+
+size_t
+mon_drain (mon_record_t* records, size_t max) {
+
+  size_t count = (history_count < max) ? history_count : max;
+  for (size_t i = 0; i < count; i += 1) {
+    records[i] = history[(history_first + i) % history_size];
+  }
+  history_first  = (history_first + count) % history_size;
+  history_count -= count;
+  return count;
+
+} // mon_drain ()
+
+
+
+void
+mon_get_stats (mon_stats_t* copy) {
+
+  *copy = stats;
+
+} // mon_get_stats ()
@@ -0,0 +1,110 @@
+// =================================================================================================================================
+/**
+ * \file   monitor.h
+ * \brief  The interface for the region-based access monitor.
+ *
+ * A simple module that is part of the `vmsim` library.  It tracks how often each part of the allocated simulated space is accessed
+ * without tracing every access.  The space is divided into regions.  Every sampling interval, one randomly chosen page per region
+ * has its reference bit harvested; over an aggregation interval, the number of samples that found the page referenced estimates the
+ * access frequency of the whole region.  At the end of each aggregation interval, adjacent regions with similar frequencies are
+ * merged, and each region is then split at a random point, so that the regions adapt to the access pattern while their number, and
+ * with it the monitor's overhead, stays within fixed bounds whatever the size of the space.  Each aggregation appends one record
+ * per region to a bounded time series.  Each address space is monitored apart from the others:  its regions cover only its own
+ * allocated space, its intervals count only its own accesses, and its records are tagged with the space.
+ *
+ * The monitor is enabled by setting `VMSIM_MONITOR`.  `VMSIM_MONITOR_SAMPLE` gives the sampling interval in accesses,
+ * `VMSIM_MONITOR_AGGREGATE` the number of samples per aggregation, `VMSIM_MONITOR_MIN_REGIONS` and `VMSIM_MONITOR_MAX_REGIONS`
+ * the bounds on the number of regions, and `VMSIM_MONITOR_HISTORY` the number of records kept.
+ */
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_MONITOR_H)
+#define _MONITOR_H
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// TYPES
+
+/** A function that reports whether a page of a space has been referenced since it was last asked, and clears the reference. */
+typedef bool (*mon_harvest_t) (int space, vmsim_addr_t page_addr);
+
+/** One region, as it stood at the end of an aggregation interval. */
+typedef struct {
+  int          space;       /**< The address space whose pages the region covers. */
+  uint64_t     aggregation; /**< The number of the space's aggregation interval, counting from 0. */
+  vmsim_addr_t start;       /**< The simulated address of the region's first page. */
+  vmsim_addr_t end;         /**< The simulated address just past the region's last page. */
+  unsigned int accesses;    /**< The samples in the interval that found the region referenced. */
+  unsigned int age;         /**< The number of aggregation intervals for which the frequency has held steady. */
+} mon_record_t;
+
+/** Counters describing the access monitor. */
+typedef struct {
+  uint64_t samples;      /**< Sampling intervals completed. */
+  uint64_t checks;       /**< Reference bits harvested, which bounds the monitor's overhead. */
+  uint64_t aggregations; /**< Aggregation intervals completed, over all spaces. */
+  uint64_t merges;       /**< Pairs of regions merged. */
+  uint64_t splits;       /**< Regions split. */
+  uint64_t dropped;      /**< Records overwritten before being drained. */
+  unsigned int regions;  /**< The current number of regions, over all spaces. */
+} mon_stats_t;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// FUNCTIONS
+
+/**
+ * \brief  Initialize the access monitor, reading its configuration from the environment.
+ * \param  harvest The function with which to sample reference bits.
+ * \param  spaces  The number of address spaces that may be monitored.
+ * \return whether monitoring is enabled.
+ */
+bool   mon_init      (mon_harvest_t harvest, int spaces);
+
+/**
+ * \brief  Count one access by a space, sampling and aggregating the space's regions when their intervals elapse.
+ * \param  space The address space that made the access.
+ * \param  limit The simulated address just past the space's allocated space, which bounds its monitored range.
+ */
+void   mon_tick      (int space, vmsim_addr_t limit);
+
+/**
+ * \brief  Remove the oldest records from the time series.
+ * \param  records A space into which to copy the records, oldest first.
+ * \param  max     The most records to copy.
+ * \return the number of records copied.
+ */
+size_t mon_drain     (mon_record_t* records, size_t max);
+
+/**
+ * \brief  Report the activity of the access monitor.
+ * \param  stats A space into which to copy the counters.
+ */
+void   mon_get_stats (mon_stats_t* stats);
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+#endif // _MONITOR_H
+// =================================================================================================================================
@@ -0,0 +1,292 @@
+// =================================================================================================================================
+/**
+ * pagecopy.c
+ *
+ * Copy and zero whole pages with SIMD kernels, using non-temporal stores for pages that should not displace the host's caches.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pagecopy.h"
+#if defined (__x86_64__) || defined (__i386__)
+#include <immintrin.h>
+#endif
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+#define PAGESIZE          4096
+#define STREAM_ALIGNMENT  64
+#define IS_ALIGNED(p)     (((uintptr_t)(p) & (STREAM_ALIGNMENT - 1)) == 0)
+
+typedef void (*copy_kernel_t) (void* dst, const void* src, bool stream);
+typedef void (*zero_kernel_t) (void* dst, bool stream);
+
+static void generic_copy (void* dst, const void* src, bool stream);
+static void generic_zero (void* dst, bool stream);
+
+// The kernels in use, which start out generic so that pages can be moved before `pc_init()` has run.
+static copy_kernel_t copy_kernel = generic_copy;
+static zero_kernel_t zero_kernel = generic_zero;
+static bool          ready       = false;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// KERNELS
+
+static void
+generic_copy (void* dst, const void* src, bool stream) {
+
+  (void)stream;
+  memcpy(dst, src, PAGESIZE);
+
+}
+
+
+
+static void
+generic_zero (void* dst, bool stream) {
+
+  (void)stream;
+  memset(dst, 0, PAGESIZE);
+
+}
+
+
+
+#if defined (__x86_64__) || defined (__i386__)
+// Each kernel moves four vectors per iteration, and fences after non-temporal stores so that they are ordered before any later
+// store that publishes the page.
+
+__attribute__((target("sse2"))) static void
+sse2_copy (void* dst, const void* src, bool stream) {
+
+  __m128i*       d = dst;
+  const __m128i* s = src;
+  for (int i = 0; i < PAGESIZE / (int)sizeof(__m128i); i += 4) {
+    __m128i a = _mm_loadu_si128(s + i);
+    __m128i b = _mm_loadu_si128(s + i + 1);
+    __m128i c = _mm_loadu_si128(s + i + 2);
+    __m128i e = _mm_loadu_si128(s + i + 3);
+    if (stream) {
+      _mm_stream_si128(d + i, a);
+      _mm_stream_si128(d + i + 1, b);
+      _mm_stream_si128(d + i + 2, c);
+      _mm_stream_si128(d + i + 3, e);
+    } else {
+      _mm_store_si128(d + i, a);
+      _mm_store_si128(d + i + 1, b);
+      _mm_store_si128(d + i + 2, c);
+      _mm_store_si128(d + i + 3, e);
+    }
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+
+}
+
+
+
+__attribute__((target("sse2"))) static void
+sse2_zero (void* dst, bool stream) {
+
+  __m128i* d    = dst;
+  __m128i  zero = _mm_setzero_si128();
+  for (int i = 0; i < PAGESIZE / (int)sizeof(__m128i); i += 1) {
+    if (stream) {
+      _mm_stream_si128(d + i, zero);
+    } else {
+      _mm_store_si128(d + i, zero);
+    }
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+
+}
+
+
+
+__attribute__((target("avx2"))) static void
+avx2_copy (void* dst, const void* src, bool stream) {
+
+  __m256i*       d = dst;
+  const __m256i* s = src;
+  for (int i = 0; i < PAGESIZE / (int)sizeof(__m256i); i += 4) {
+    __m256i a = _mm256_loadu_si256(s + i);
+    __m256i b = _mm256_loadu_si256(s + i + 1);
+    __m256i c = _mm256_loadu_si256(s + i + 2);
+    __m256i e = _mm256_loadu_si256(s + i + 3);
+    if (stream) {
+      _mm256_stream_si256(d + i, a);
+      _mm256_stream_si256(d + i + 1, b);
+      _mm256_stream_si256(d + i + 2, c);
+      _mm256_stream_si256(d + i + 3, e);
+    } else {
+      _mm256_store_si256(d + i, a);
+      _mm256_store_si256(d + i + 1, b);
+      _mm256_store_si256(d + i + 2, c);
+      _mm256_store_si256(d + i + 3, e);
+    }
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+
+}
+
+
+
+__attribute__((target("avx2"))) static void
+avx2_zero (void* dst, bool stream) {
+
+  __m256i* d    = dst;
+  __m256i  zero = _mm256_setzero_si256();
+  for (int i = 0; i < PAGESIZE / (int)sizeof(__m256i); i += 1) {
+    if (stream) {
+      _mm256_stream_si256(d + i, zero);
+    } else {
+      _mm256_store_si256(d + i, zero);
+    }
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+
+}
+
+
+
+__attribute__((target("avx512f"))) static void
+avx512_copy (void* dst, const void* src, bool stream) {
+
+  __m512i*       d = dst;
+  const __m512i* s = src;
+  for (int i = 0; i < PAGESIZE / (int)sizeof(__m512i); i += 4) {
+    __m512i a = _mm512_loadu_si512(s + i);
+    __m512i b = _mm512_loadu_si512(s + i + 1);
+    __m512i c = _mm512_loadu_si512(s + i + 2);
+    __m512i e = _mm512_loadu_si512(s + i + 3);
+    if (stream) {
+      _mm512_stream_si512(d + i, a);
+      _mm512_stream_si512(d + i + 1, b);
+      _mm512_stream_si512(d + i + 2, c);
+      _mm512_stream_si512(d + i + 3, e);
+    } else {
+      _mm512_store_si512(d + i, a);
+      _mm512_store_si512(d + i + 1, b);
+      _mm512_store_si512(d + i + 2, c);
+      _mm512_store_si512(d + i + 3, e);
+    }
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+
+}
+
+
+
+__attribute__((target("avx512f"))) static void
+avx512_zero (void* dst, bool stream) {
+
+  __m512i* d    = dst;
+  __m512i  zero = _mm512_setzero_si512();
+  for (int i = 0; i < PAGESIZE / (int)sizeof(__m512i); i += 1) {
+    if (stream) {
+      _mm512_stream_si512(d + i, zero);
+    } else {
+      _mm512_store_si512(d + i, zero);
+    }
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+
+}
+#endif
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+pc_init () {
+
+  // Only initialize if it hasn't already happened.
+  if (ready) {
+    return;
+  }
+  ready = true;
+
+#if defined (__x86_64__) || defined (__i386__)
+  // Take the widest supported kernel, unless the environment names another that is also supported.
+  char* kernel_envvar = getenv("VMSIM_PAGE_COPY");
+  bool  automatic     = (kernel_envvar == NULL || strcmp(kernel_envvar, "auto") == 0);
+  __builtin_cpu_init();
+  if ((automatic || strcmp(kernel_envvar, "avx512") == 0) && __builtin_cpu_supports("avx512f")) {
+    copy_kernel = avx512_copy;
+    zero_kernel = avx512_zero;
+  } else if ((automatic || strcmp(kernel_envvar, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+    copy_kernel = avx2_copy;
+    zero_kernel = avx2_zero;
+  } else if ((automatic || strcmp(kernel_envvar, "sse2") == 0) && __builtin_cpu_supports("sse2")) {
+    copy_kernel = sse2_copy;
+    zero_kernel = sse2_zero;
+  }
+#endif
+
+} // pc_init ()
+
+
+
+// The vector kernels need an aligned destination; anything else, such as a staging buffer from the caller, takes the generic path.
+
+void
+pc_copy (void* dst, const void* src) {
+
+  (IS_ALIGNED(dst) ? copy_kernel : generic_copy)(dst, src, false);
+
+} // pc_copy ()
+
+
+
+void
+pc_stream (void* dst, const void* src) {
+
+  (IS_ALIGNED(dst) ? copy_kernel : generic_copy)(dst, src, true);
+
+} // pc_stream ()
+
+
+
+void
+pc_zero (void* dst) {
+
+  (IS_ALIGNED(dst) ? zero_kernel : generic_zero)(dst, false);
+
+} // pc_zero ()
+
+
+
+void
+pc_zero_stream (void* dst) {
+
+  (IS_ALIGNED(dst) ? zero_kernel : generic_zero)(dst, true);
+
+} // pc_zero_stream ()
+
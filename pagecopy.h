@@ -0,0 +1,65 @@
+// =================================================================================================================================
+/**
+ * \file   pagecopy.h
+ * \brief  The interface for the page copy and zero kernels.
+ *
+ * A simple module that is part of the `vmsim` library.  Whole pages are moved in two ways.  Pages that are about to be accessed,
+ * such as a frame receiving a swapped-in page, are copied or zeroed with ordinary stores, so that they arrive in the host's caches.
+ * Pages that are merely passing through, such as a page on its way to the backing store, use non-temporal stores that bypass the
+ * caches, so that swap traffic does not evict the simulator's own page tables and frame table.  The kernels use the widest of
+ * SSE2, AVX2 and AVX-512 that the host supports, chosen at run time; `VMSIM_PAGE_COPY` may name one of `memcpy`, `sse2`, `avx2` or
+ * `avx512` to override the choice.
+ */
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_PAGECOPY_H)
+#define _PAGECOPY_H
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// FUNCTIONS
+
+/**
+ * \brief  Choose the kernels, reading any override from the environment.
+ */
+void pc_init         ();
+
+/**
+ * \brief  Copy a page that is about to be accessed.
+ * \param  dst The page-aligned destination.
+ * \param  src The source.
+ */
+void pc_copy         (void* dst, const void* src);
+
+/**
+ * \brief  Copy a page that will not be accessed soon, bypassing the caches where possible.
+ * \param  dst The page-aligned destination.
+ * \param  src The source.
+ */
+void pc_stream       (void* dst, const void* src);
+
+/**
+ * \brief  Zero a page that is about to be accessed.
+ * \param  dst The page-aligned destination.
+ */
+void pc_zero         (void* dst);
+
+/**
+ * \brief  Zero a page that will not be accessed soon, bypassing the caches where possible.
+ * \param  dst The page-aligned destination.
+ */
+void pc_zero_stream  (void* dst);
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+#endif // _PAGECOPY_H
+// =================================================================================================================================
@@ -0,0 +1,252 @@
+// =================================================================================================================================
+/**
+ * pager.c
+ *
+ * Keep the pagers registered over ranges of simulated space, and deliver their fills and writebacks in batches.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdlib.h>
+#include "pagecopy.h"
+#include "pager.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+#define PAGESIZE               4096
+#define MAX_PAGERS             16
+#define DEFAULT_PAGER_BATCH    16
+#define MAX_PAGER_BATCH        256
+
+// One pager:  the range it covers, its callbacks, and the writebacks staged for it, whose data lies in `staging`, one page each.
+typedef struct {
+  int               space;
+  uint64_t          first;
+  uint64_t          end;
+  vmsim_pager_ops_t ops;
+  uint8_t*          staging;
+  size_t            staged;
+  vmsim_addr_t      staged_pages[MAX_PAGER_BATCH];
+} pager_t;
+
+// One queued fill.
+typedef struct {
+  int          pager;
+  vmsim_addr_t page;
+  void*        buffer;
+} fill_t;
+
+static bool     ready       = false;
+static size_t   batch_size  = DEFAULT_PAGER_BATCH;
+static pager_t  pagers[MAX_PAGERS];
+static int      pager_count = 0;
+static fill_t   fills[MAX_PAGER_BATCH];
+static size_t   fill_count  = 0;
+
+static vmsim_pager_stats_t stats;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+pg_init () {
+
+  // Only initialize if it hasn't already happened.
+  if (!ready) {
+
+    char* batch_envvar = getenv("VMSIM_PAGER_BATCH");
+    if (batch_envvar != NULL) {
+      batch_size = strtoull(batch_envvar, NULL, 10);
+    }
+    assert(batch_size > 0 && batch_size <= MAX_PAGER_BATCH);
+    ready = true;
+
+  }
+
+} // pg_init ()
+
+
+
+int
+pg_register (int space, vmsim_addr_t addr, size_t size, const vmsim_pager_ops_t* ops) {
+
+  uint64_t end = (uint64_t)addr + size;
+  assert(pager_count < MAX_PAGERS && ops != NULL && ops->fill != NULL);
+  assert((addr % PAGESIZE) == 0 && size > 0 && (size % PAGESIZE) == 0 && end <= ((uint64_t)1 << 32));
+  for (int i = 0; i < pager_count; i += 1) {
+    assert(pagers[i].space != space || end <= pagers[i].first || addr >= pagers[i].end);
+  }
+
+  pager_t* pager = &pagers[pager_count];
+  pager->space   = space;
+  pager->first   = addr;
+  pager->end     = end;
+  pager->ops     = *ops;
+  pager->staged  = 0;
+  pager->staging = NULL;
+  if (ops->writeback != NULL) {
+    int result = posix_memalign((void**)&pager->staging, PAGESIZE, batch_size * PAGESIZE);
+    assert(result == 0);
+  }
+  stats.pagers += 1;
+  return pager_count++;
+
+} // pg_register ()
+
+
+
+int
+pg_find (int space, vmsim_addr_t sim_addr) {
+
+  for (int i = 0; i < pager_count; i += 1) {
+    if (pagers[i].space == space && sim_addr >= pagers[i].first && sim_addr < pagers[i].end) {
+      return i;
+    }
+  }
+  return -1;
+
+} // pg_find ()
+
+
+
+/**
+ * Deliver a pager's staged writebacks in one call.
+ */
+void
+flush_writebacks (pager_t* pager) {
+
+  if (pager->staged == 0) {
+    return;
+  }
+  const void* buffers[MAX_PAGER_BATCH];
+  for (size_t i = 0; i < pager->staged; i += 1) {
+    buffers[i] = pager->staging + (i * PAGESIZE);
+  }
+  pager->ops.writeback(pager->ops.context, pager->staged_pages, buffers, pager->staged);
+  stats.writeback_batches += 1;
+  pager->staged            = 0;
+
+} // flush_writebacks ()
+
+
+
+void
+pg_fill (int pager, vmsim_addr_t page, void* buffer) {
+
+  assert(pager >= 0 && pager < pager_count);
+  if (fill_count == batch_size) {
+    pg_flush();
+  }
+  fills[fill_count].pager  = pager;
+  fills[fill_count].page   = page;
+  fills[fill_count].buffer = buffer;
+  fill_count              += 1;
+  stats.fills             += 1;
+
+} // pg_fill ()
+
+
+
+void
+pg_writeback (int pager_no, vmsim_addr_t page, const void* buffer) {
+
+  assert(pager_no >= 0 && pager_no < pager_count);
+  pager_t* pager = &pagers[pager_no];
+  if (pager->ops.writeback == NULL) {
+    stats.discards += 1;
+    return;
+  }
+
+  // A page staged earlier is replaced, since only its latest data need reach the pager.
+  size_t slot = 0;
+  while (slot < pager->staged && pager->staged_pages[slot] != page) {
+    slot += 1;
+  }
+  if (slot == batch_size) {
+    flush_writebacks(pager);
+    slot = 0;
+  }
+  pc_copy(pager->staging + (slot * PAGESIZE), buffer);
+  pager->staged_pages[slot] = page;
+  if (slot == pager->staged) {
+    pager->staged += 1;
+  }
+  stats.writebacks += 1;
+
+} // pg_writeback ()
+
+
+
+void
+pg_discard () {
+
+  stats.discards += 1;
+
+} // pg_discard ()
+
+
+
+void
+pg_flush () {
+
+  for (int i = 0; i < pager_count; i += 1) {
+    flush_writebacks(&pagers[i]);
+  }
+
+  // Deliver the fills one pager at a time, each pager's in the order they were queued.
+  vmsim_addr_t pages[MAX_PAGER_BATCH];
+  void*        buffers[MAX_PAGER_BATCH];
+  size_t       delivered = 0;
+  while (delivered < fill_count) {
+    int    pager = -1;
+    size_t count = 0;
+    for (size_t i = 0; i < fill_count; i += 1) {
+      if (fills[i].buffer == NULL || (pager != -1 && fills[i].pager != pager)) {
+        continue;
+      }
+      pager           = fills[i].pager;
+      pages[count]    = fills[i].page;
+      buffers[count]  = fills[i].buffer;
+      fills[i].buffer = NULL;
+      count          += 1;
+    }
+    pagers[pager].ops.fill(pagers[pager].ops.context, pages, buffers, count);
+    stats.fill_batches += 1;
+    delivered          += count;
+  }
+  fill_count = 0;
+
+} // pg_flush ()
+
+
+
+void
+pg_complete_fill (const void* buffer) {
+
+  for (size_t i = 0; i < fill_count; i += 1) {
+    if (fills[i].buffer == buffer) {
+      pg_flush();
+      return;
+    }
+  }
+
+} // pg_complete_fill ()
+
+
+
+void
+pg_get_stats (vmsim_pager_stats_t* copy) {
+
+  *copy = stats;
+
+} // pg_get_stats ()
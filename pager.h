@@ -0,0 +1,106 @@
+// =================================================================================================================================
+/**
+ * \file   pager.h
+ * \brief  The interface for the pagers that supply ranges of simulated space in place of the backing store.
+ *
+ * A simple module that is part of the `vmsim` library.  It keeps the registered pagers, each covering a range of one address space,
+ * and batches the calls made to them.  Fills are queued with the buffer they are to fill, which must stay in place until they are
+ * flushed.  Writebacks are copied at once into a staging area of the pager's own, so that the frame they came from can be reused
+ * straight away.  A flush delivers the staged writebacks before the queued fills, so that a page written back and then filled again
+ * reads its latest data.  `VMSIM_PAGER_BATCH` gives the number of fills, and of each pager's writebacks, that may gather before a
+ * flush is forced (default 16).
+ */
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_PAGER_H)
+#define _PAGER_H
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// FUNCTIONS
+
+/**
+ * \brief  Initialize the pagers, reading their configuration from the environment.
+ */
+void pg_init          ();
+
+/**
+ * \brief  Register a pager over a range of an address space.
+ * \param  space The address space.
+ * \param  addr  The _simulated_ address of the range, which must be page-aligned.
+ * \param  size  The length of the range, in bytes, which must be a whole number of pages.
+ * \param  ops   The pager's callbacks.
+ * \return the pager's number.
+ */
+int  pg_register      (int space, vmsim_addr_t addr, size_t size, const vmsim_pager_ops_t* ops);
+
+/**
+ * \brief  Find the pager covering a page.
+ * \param  space    The address space.
+ * \param  sim_addr The _simulated_ address of the page.
+ * \return the pager's number, or -1 if no pager covers the page.
+ */
+int  pg_find          (int space, vmsim_addr_t sim_addr);
+
+/**
+ * \brief  Queue a page to be filled by its pager, flushing first if the queue is full.
+ * \param  pager  The pager's number.
+ * \param  page   The _simulated_ base address of the page.
+ * \param  buffer The page-sized space to fill, which must stay in place until the next flush.
+ */
+void pg_fill          (int pager, vmsim_addr_t page, void* buffer);
+
+/**
+ * \brief  Stage a modified page to be written back to its pager, flushing the pager's writebacks first if its staging area is full.
+ * \param  pager  The pager's number.
+ * \param  page   The _simulated_ base address of the page.
+ * \param  buffer The page's data, which is copied before this function returns.
+ */
+void pg_writeback     (int pager, vmsim_addr_t page, const void* buffer);
+
+/**
+ * \brief  Count a clean page dropped from real memory without a writeback.
+ */
+void pg_discard       ();
+
+/**
+ * \brief  Deliver every staged writeback, and then every queued fill.
+ */
+void pg_flush         ();
+
+/**
+ * \brief  Flush, if a fill is queued for a buffer, so that no fill is left pending on a frame that is about to be moved or reused.
+ * \param  buffer The buffer.
+ */
+void pg_complete_fill (const void* buffer);
+
+/**
+ * \brief  Report the activity of the pagers.
+ * \param  stats A space into which to copy the counters.
+ */
+void pg_get_stats     (vmsim_pager_stats_t* stats);
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+#endif // _PAGER_H
+// =================================================================================================================================
@@ -0,0 +1,181 @@
+// =================================================================================================================================
+/**
+ * \file   pff-check.c
+ * \brief  Run a small and a thrashing address space side by side under local replacement with page-fault-frequency control, over
+ *         tiered real memory, and check that the small space keeps its working set, and wins frames back when it grows.  Use the
+ *         `vmsim` library for the pages.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+/** The number of bytes in a page. */
+#define PAGESIZE     4096
+
+/** Real memory:  the page table area, then 160 frames, of which the top 32 form the slow tier. */
+#define REAL_SIZE    "4853760"
+#define SLOW_SIZE    "131072"
+
+/** The small space's working set, before and after it grows; the thrashing space's pages; and the accesses each makes per turn. */
+#define SMALL_PAGES  40
+#define GROWN_PAGES  60
+#define LARGE_PAGES  400
+#define QUANTUM      500
+#define TURNS        200
+
+/** The small space's allotment while it fills, and the pages that the large space writes between sweeps of the small one. */
+#define CUT_PAGES    20
+#define SWEEPS       40
+
+/** The controller's default bound on faults per thousand accesses, above which a space's allotment grows. */
+#define PFF_UPPER    20
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Read random pages of one space's block, checking that each holds its own number.
+ * \param space The space to switch to.
+ * \param base  The simulated address of the block.
+ * \param pages The number of pages among which to choose.
+ */
+void
+run_turn (int space, vmsim_addr_t base, uint32_t pages) {
+
+  vmsim_space_switch(space);
+  for (uint32_t i = 0; i < QUANTUM; i += 1) {
+    uint32_t page = random() % pages;
+    uint32_t value;
+    vmsim_read(&value, base + (page * PAGESIZE), sizeof(value));
+    assert(value == page);
+  }
+
+} // run_turn ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Write their own numbers into a range of pages of one space's block.
+ * \param space The space to switch to.
+ * \param base  The simulated address of the block.
+ * \param first The first page to write.
+ * \param end   The page after the last to write.
+ */
+void
+write_pages (int space, vmsim_addr_t base, uint32_t first, uint32_t end) {
+
+  vmsim_space_switch(space);
+  for (uint32_t page = first; page < end; page += 1) {
+    vmsim_write(&page, base + (page * PAGESIZE), sizeof(page));
+  }
+
+} // write_pages ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Read every page of one space's block in turn, checking that each holds its own number.
+ * \param space The space to switch to.
+ * \param base  The simulated address of the block.
+ * \param pages The number of pages in the block.
+ */
+void
+sweep_pages (int space, vmsim_addr_t base, uint32_t pages) {
+
+  vmsim_space_switch(space);
+  for (uint32_t page = 0; page < pages; page += 1) {
+    uint32_t value;
+    vmsim_read(&value, base + (page * PAGESIZE), sizeof(value));
+    assert(value == page);
+  }
+
+} // sweep_pages ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Promote pages during eviction sweeps, alternate turns of the two spaces, then let the small one's working set grow, and
+ *        check the faults and allotments.
+ * \return the exit code for the process, where 0 indicates success.
+ */
+int
+main () {
+
+  setenv("VMSIM_REAL_MEM_SIZE", REAL_SIZE, 1);
+  setenv("VMSIM_SLOW_MEM_SIZE", SLOW_SIZE, 1);
+  setenv("VMSIM_REPLACEMENT",   "local",   1);
+  setenv("VMSIM_PFF_CONTROL",   "1",       1);
+  srandom(100);
+  int          large      = vmsim_space_create(0);
+  vmsim_addr_t small_base = vmsim_alloc(GROWN_PAGES * PAGESIZE);
+  vmsim_space_switch(large);
+  vmsim_addr_t large_base = vmsim_alloc(LARGE_PAGES * PAGESIZE);
+
+  // Written beyond a cut allotment, the small space fills the slow tier.  With its allotment raised again, its hot pages there are
+  // promoted into free frames from within the eviction sweeps that the large space, held to two frames, drives as it writes.  The
+  // large space rewrites all its pages each time, so that none it has pushed down is cold enough to end a sweep early.
+  vmsim_space_set_allotment(0, CUT_PAGES);
+  write_pages(0, small_base, 0, GROWN_PAGES);
+  vmsim_space_set_allotment(0, GROWN_PAGES);
+  vmsim_space_set_allotment(large, 2);
+  for (uint32_t page = 0; page < SWEEPS; page += 1) {
+    sweep_pages(0, small_base, GROWN_PAGES);
+    write_pages(large, large_base, 0, page + 1);
+  }
+  write_pages(large, large_base, SWEEPS, LARGE_PAGES);
+
+  // Once its allotment settles on its working set, the small space stops faulting, however hard the large one thrashes.
+  vmsim_space_stats_t small;
+  for (uint32_t turn = 0; turn < TURNS; turn += 1) {
+    run_turn(0, small_base, SMALL_PAGES);
+    run_turn(large, large_base, LARGE_PAGES);
+    if (turn == TURNS / 2) {
+      vmsim_get_space_stats(0, &small);
+    }
+  }
+  vmsim_space_stats_t settled;
+  vmsim_get_space_stats(0, &settled);
+  assert(settled.faults == small.faults && settled.allotment >= SMALL_PAGES);
+
+  // A larger working set drives the small space's fault frequency up, and it takes back frames until that falls within bounds.
+  for (uint32_t turn = 0; turn < TURNS; turn += 1) {
+    run_turn(0, small_base, GROWN_PAGES);
+    run_turn(large, large_base, LARGE_PAGES);
+    if (turn == TURNS / 2) {
+      vmsim_get_space_stats(0, &small);
+    }
+  }
+  vmsim_space_stats_t grown;
+  vmsim_get_space_stats(0, &grown);
+  assert(grown.allotment > SMALL_PAGES && (grown.faults - small.faults) * 1000 <= PFF_UPPER * (TURNS / 2) * QUANTUM);
+
+  vmsim_tier_stats_t tiers;
+  vmsim_get_tier_stats(&tiers);
+  printf("pff-check: small space allotted %lu frames after %lu faults; %lu promotions\n", (unsigned long)grown.allotment,
+         grown.faults, tiers.promotions);
+  return 0;
+
+} // main ()
+// =================================================================================================================================
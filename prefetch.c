@@ -0,0 +1,229 @@
+// =================================================================================================================================
+/**
+ * prefetch.c
+ *
+ * Predict upcoming page faults from per-region strides and from fault-to-fault correlations.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <stdlib.h>
+#include "prefetch.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+#define PAGE_SHIFT        12
+#define REGION_SHIFT      22
+#define STRIDE_ENTRIES    64
+#define MARKOV_ENTRIES    4096
+#define DEFAULT_DEGREE    4
+#define ACCURACY_WINDOW   64
+#define LOW_ACCURACY      50
+#define HIGH_ACCURACY     75
+#define PROBE_INTERVAL    64
+#define NO_PAGE           UINT32_MAX
+
+// The stride learned for one region:  the last page that faulted in it, the distance to the one before, and how many times in a
+// row that distance has repeated.
+typedef struct {
+  uint32_t region;
+  uint32_t last_page;
+  int64_t  stride;
+  int      confidence;
+} stride_entry_t;
+
+// The page that last faulted after a given page.
+typedef struct {
+  uint32_t page;
+  uint32_t next;
+} markov_entry_t;
+
+static bool           enabled       = false;
+static bool           ready         = false;
+static unsigned int   max_degree    = DEFAULT_DEGREE;
+static stride_entry_t strides[STRIDE_ENTRIES];
+static markov_entry_t successors[MARKOV_ENTRIES];
+static uint32_t       previous_page = NO_PAGE;
+
+// The accuracy of the prefetches resolved since the degree was last adjusted.
+static unsigned int   window_resolved = 0;
+static unsigned int   window_useful   = 0;
+
+static pf_stats_t     stats;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+bool
+pf_init () {
+
+  // Only initialize if it hasn't already happened.
+  if (!ready) {
+
+    char* enabled_envvar = getenv("VMSIM_PREFETCH");
+    enabled = (enabled_envvar != NULL && enabled_envvar[0] != '0');
+    char* degree_envvar = getenv("VMSIM_PREFETCH_DEGREE");
+    if (degree_envvar != NULL) {
+      max_degree = strtoul(degree_envvar, NULL, 10);
+    }
+    stats.degree = max_degree;
+    for (int i = 0; i < STRIDE_ENTRIES; i += 1) {
+      strides[i].region = NO_PAGE;
+    }
+    for (int i = 0; i < MARKOV_ENTRIES; i += 1) {
+      successors[i].page = NO_PAGE;
+    }
+    ready = true;
+
+  }
+  return enabled;
+
+}
+
+
+
+/**
+ * Add a page to a list of predictions, unless it is already there or is not a valid page.
+ *
+ * \return the new length of the list.
+ */
+int
+add_prediction (vmsim_addr_t* predictions, int count, int64_t page) {
+
+  if (page <= 0 || page >= (1L << (32 - PAGE_SHIFT))) {
+    return count;
+  }
+  vmsim_addr_t page_addr = (vmsim_addr_t)page << PAGE_SHIFT;
+  for (int i = 0; i < count; i += 1) {
+    if (predictions[i] == page_addr) {
+      return count;
+    }
+  }
+  predictions[count] = page_addr;
+  return count + 1;
+
+}
+
+
+
+int
+pf_fault (vmsim_addr_t page_addr, bool swap_in, vmsim_addr_t* predictions, int max) {
+
+  uint32_t page = page_addr >> PAGE_SHIFT;
+  stats.faults += 1;
+  if (swap_in) {
+    stats.demand_swap_ins += 1;
+  }
+
+  // Correlate this fault with the one before it.
+  if (previous_page != NO_PAGE) {
+    markov_entry_t* entry = &successors[previous_page % MARKOV_ENTRIES];
+    entry->page = previous_page;
+    entry->next = page;
+  }
+  previous_page = page;
+
+  // Learn the stride within this page's region.
+  uint32_t        region = page_addr >> REGION_SHIFT;
+  stride_entry_t* entry  = &strides[region % STRIDE_ENTRIES];
+  if (entry->region != region) {
+    entry->region     = region;
+    entry->stride     = 0;
+    entry->confidence = 0;
+  } else {
+    int64_t stride = (int64_t)page - entry->last_page;
+    if (stride != 0 && stride == entry->stride) {
+      entry->confidence += 1;
+    } else {
+      entry->stride     = stride;
+      entry->confidence = 0;
+    }
+  }
+  entry->last_page = page;
+
+  // With the degree throttled to nothing, still probe now and then so that accuracy can recover.
+  int limit = (stats.degree < (unsigned int)max) ? (int)stats.degree : max;
+  if (limit == 0 && stats.faults % PROBE_INTERVAL == 0 && max > 0) {
+    limit = 1;
+  }
+
+  // Prefer a stride that has repeated, then follow the chain of correlated faults.
+  int count = 0;
+  if (entry->confidence > 0) {
+    for (int i = 1; count < limit && i <= limit; i += 1) {
+      count = add_prediction(predictions, count, (int64_t)page + (i * entry->stride));
+    }
+  }
+  uint32_t current = page;
+  for (int i = 0; count < limit && i < limit; i += 1) {
+    markov_entry_t* successor = &successors[current % MARKOV_ENTRIES];
+    if (successor->page != current) {
+      break;
+    }
+    current = successor->next;
+    count   = add_prediction(predictions, count, current);
+  }
+
+  stats.predicted += count;
+  return count;
+
+} // pf_fault ()
+
+
+
+void
+pf_issued () {
+
+  stats.issued += 1;
+
+} // pf_issued ()
+
+
+
+void
+pf_resolve (bool useful) {
+
+  if (useful) {
+    stats.useful  += 1;
+    window_useful += 1;
+  } else {
+    stats.useless += 1;
+  }
+
+  // Once a window of prefetches is resolved, back off sharply on poor accuracy and creep back up on good accuracy.
+  window_resolved += 1;
+  if (window_resolved == ACCURACY_WINDOW) {
+    unsigned int accuracy = (window_useful * 100) / window_resolved;
+    if (accuracy < LOW_ACCURACY && stats.degree > 0) {
+      stats.degree    /= 2;
+      stats.throttled += 1;
+    } else if (accuracy >= HIGH_ACCURACY && stats.degree < max_degree) {
+      stats.degree    += 1;
+    }
+    window_resolved = 0;
+    window_useful   = 0;
+  }
+
+} // pf_resolve ()
+
+
+
+void
+pf_get_stats (pf_stats_t* copy) {
+
+  uint64_t resolved = stats.useful + stats.useless;
+  uint64_t needed   = stats.useful + stats.demand_swap_ins;
+  *copy             = stats;
+  copy->accuracy    = (resolved == 0) ? 0.0 : (double)stats.useful / resolved;
+  copy->coverage    = (needed == 0)   ? 0.0 : (double)stats.useful / needed;
+
+} // pf_get_stats ()
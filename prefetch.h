@@ -0,0 +1,96 @@
+// =================================================================================================================================
+/**
+ * \file   prefetch.h
+ * \brief  The interface for the fault-stream prefetcher.
+ *
+ * A simple module that is part of the `vmsim` library.  It watches the stream of page faults and predicts the pages that will fault
+ * next, from two sources:  a constant stride learned per 4 MB region of the simulated space, and a correlation table that
+ * remembers, for each faulting page, the page that faulted after it last time.  The library swaps predicted pages in ahead of
+ * demand.  The prefetcher is enabled by setting `VMSIM_PREFETCH`; `VMSIM_PREFETCH_DEGREE` bounds the number of pages predicted per
+ * fault.  The degree adapts to the measured accuracy, shrinking when too few prefetched pages are used.
+ */
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_PREFETCH_H)
+#define _PREFETCH_H
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// TYPES
+
+/** Counters describing the prefetcher. */
+typedef struct {
+  uint64_t faults;          /**< Faults observed. */
+  uint64_t demand_swap_ins; /**< Faults that had to swap a page in. */
+  uint64_t predicted;       /**< Pages predicted. */
+  uint64_t issued;          /**< Predicted pages that were swapped in. */
+  uint64_t useful;          /**< Prefetched pages referenced before their eviction. */
+  uint64_t useless;         /**< Prefetched pages evicted without being referenced. */
+  uint64_t throttled;       /**< Times the degree was reduced for low accuracy. */
+  unsigned int degree;      /**< The current number of pages predicted per fault. */
+  double   accuracy;        /**< The share of resolved prefetches that were useful:  `useful / (useful + useless)`. */
+  double   coverage;        /**< The share of swap-ins that prefetching spared a fault:  `useful / (useful + demand_swap_ins)`. */
+} pf_stats_t;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// FUNCTIONS
+
+/**
+ * \brief  Initialize the prefetcher, reading its configuration from the environment.
+ * \return whether prefetching is enabled.
+ */
+bool pf_init      ();
+
+/**
+ * \brief  Record a fault and predict the pages that will fault next.
+ * \param  page_addr   The simulated base address of the faulting page.
+ * \param  swap_in     Whether the fault had to swap the page in.
+ * \param  predictions A space into which to store the simulated base addresses of the predicted pages.
+ * \param  max         The most predictions to store.
+ * \return the number of predictions stored.
+ */
+int  pf_fault     (vmsim_addr_t page_addr, bool swap_in, vmsim_addr_t* predictions, int max);
+
+/**
+ * \brief  Record that a predicted page was swapped in.
+ */
+void pf_issued    ();
+
+/**
+ * \brief  Record what became of a prefetched page.
+ * \param  useful Whether the page was referenced before it was evicted.
+ */
+void pf_resolve   (bool useful);
+
+/**
+ * \brief  Report the activity of the prefetcher.
+ * \param  stats A space into which to copy the counters.
+ */
+void pf_get_stats (pf_stats_t* stats);
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+#endif // _PREFETCH_H
+// =================================================================================================================================
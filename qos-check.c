@@ -0,0 +1,79 @@
+// =================================================================================================================================
+/**
+ * \file   qos-check.c
+ * \brief  Allocate pages of the critical and bulk QoS classes in turn, more of them than real memory holds, and check that only
+ *         bulk pages are ever displaced.  Use the `vmsim` library for the pages.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+/** The number of bytes in a page. */
+#define PAGESIZE  4096
+
+/** Real memory of 64 frames. */
+#define REAL_SIZE "4460544"
+
+/** The pairs of single-page blocks allocated, one critical and one bulk, whose critical halves alone fit in real memory. */
+#define PAIRS     48
+#define PASSES    4
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Allocate the pairs one block at a time, so that no two neighbouring blocks share a class, then sweep them all repeatedly.
+ * \return the exit code for the process, where 0 indicates success.
+ */
+int
+main () {
+
+  setenv("VMSIM_REAL_MEM_SIZE", REAL_SIZE, 1);
+  vmsim_addr_t critical[PAIRS];
+  vmsim_addr_t bulk[PAIRS];
+  for (uint32_t i = 0; i < PAIRS; i += 1) {
+    critical[i] = vmsim_alloc_flags(PAGESIZE, VMSIM_ALLOC_CLASS(VMSIM_QOS_CRITICAL));
+    bulk[i]     = vmsim_alloc_flags(PAGESIZE, VMSIM_ALLOC_CLASS(VMSIM_QOS_BULK));
+  }
+
+  for (uint32_t pass = 0; pass < PASSES; pass += 1) {
+    for (uint32_t i = 0; i < PAIRS; i += 1) {
+      uint32_t value;
+      if (pass > 0) {
+        vmsim_read(&value, critical[i], sizeof(value));
+        assert(value == (i * PASSES) + pass - 1);
+        vmsim_read(&value, bulk[i], sizeof(value));
+        assert(value == (i * PASSES) + pass - 1);
+      }
+      value = (i * PASSES) + pass;
+      vmsim_write(&value, critical[i], sizeof(value));
+      vmsim_write(&value, bulk[i], sizeof(value));
+    }
+  }
+
+  vmsim_qos_stats_t stats;
+  vmsim_get_qos_stats(&stats);
+  assert(stats.victims[VMSIM_QOS_CRITICAL] == 0 && stats.victims[VMSIM_QOS_BULK] > 0);
+  assert(stats.resident[VMSIM_QOS_CRITICAL] == PAIRS);
+  printf("qos-check: %lu bulk victims, %lu critical pages resident\n", stats.victims[VMSIM_QOS_BULK],
+         stats.resident[VMSIM_QOS_CRITICAL]);
+  return 0;
+
+} // main ()
+// =================================================================================================================================
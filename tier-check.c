@@ -0,0 +1,106 @@
+// =================================================================================================================================
+/**
+ * \file   tier-check.c
+ * \brief  Page a working set through a tiered real memory, and check that cold pages are demoted, hot ones promoted, and no data
+ *         is lost along the way.  Use the `vmsim` library for the pages.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+/** The number of bytes in a page. */
+#define PAGESIZE   4096
+
+/** Real memory:  the page table area, then 64 frames, of which the top 16 form the slow tier. */
+#define REAL_SIZE  "4460544"
+#define SLOW_SIZE  "65536"
+
+/** The pages touched, more than real memory holds; those that fill it; and the hot pages among them. */
+#define PAGES      100
+#define FILL_PAGES 60
+#define HOT_PAGES  8
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Read one word of a page and check that it holds the value last written there.
+ * \param base The simulated address of the first page.
+ * \param page The page to check.
+ * \param pass The pass in which the page was last written.
+ */
+void
+check_page (vmsim_addr_t base, uint32_t page, uint32_t pass) {
+
+  uint32_t value;
+  vmsim_read(&value, base + (page * PAGESIZE), sizeof(value));
+  assert(value == (page * 1000) + pass);
+
+} // check_page ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \brief Fill real memory, hammer the hot pages between faults on the rest, then sweep every page, checking the data throughout.
+ * \return the exit code for the process, where 0 indicates success.
+ */
+int
+main () {
+
+  setenv("VMSIM_REAL_MEM_SIZE", REAL_SIZE, 1);
+  setenv("VMSIM_SLOW_MEM_SIZE", SLOW_SIZE, 1);
+  vmsim_addr_t base = vmsim_alloc(PAGES * PAGESIZE);
+
+  // Filling real memory pushes the first pages written, the hot ones among them, down to the slow tier.
+  for (uint32_t page = 0; page < FILL_PAGES; page += 1) {
+    uint32_t value = page * 1000;
+    vmsim_write(&value, base + (page * PAGESIZE), sizeof(value));
+  }
+
+  // Hot pages referenced on consecutive samples of the slow tier, which faults drive, are promoted back to the fast tier.
+  for (uint32_t page = FILL_PAGES; page < PAGES; page += 1) {
+    for (uint32_t hot = 0; hot < HOT_PAGES; hot += 1) {
+      check_page(base, hot, 0);
+    }
+    uint32_t value = page * 1000;
+    vmsim_write(&value, base + (page * PAGESIZE), sizeof(value));
+  }
+  vmsim_tier_stats_t hammered;
+  vmsim_get_tier_stats(&hammered);
+  assert(hammered.slow_accesses > 0 && hammered.promotions > 0 && hammered.demotions > 0);
+
+  // Sweeping more pages than fit pushes every page through the slow tier and out to the backing store, and back.
+  for (uint32_t pass = 1; pass < 4; pass += 1) {
+    for (uint32_t page = 0; page < PAGES; page += 1) {
+      check_page(base, page, pass - 1);
+      uint32_t value = (page * 1000) + pass;
+      vmsim_write(&value, base + (page * PAGESIZE), sizeof(value));
+    }
+  }
+  vmsim_tier_stats_t swept;
+  vmsim_get_tier_stats(&swept);
+  assert(swept.demotions > hammered.demotions);
+
+  printf("tier-check: %lu promotions, %lu demotions\n", swept.promotions, swept.demotions);
+  return 0;
+
+} // main ()
+// =================================================================================================================================
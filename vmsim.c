@@ -12,6 +12,7 @@
 // =================================================================================================================================
 // INCLUDES
 
+#define _GNU_SOURCE
 #include <assert.h>
 #include <errno.h>
 #include <stdbool.h>
@@ -20,9 +21,17 @@
 #include <stdint.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <unistd.h>
 #include "bs.h"
+#include "cachemodel.h"
+#include "dma.h"
 #include "mmu.h"
+#include "monitor.h"
+#include "pagecopy.h"
+#include "pager.h"
+#include "prefetch.h"
 #include "vmsim.h"
+#include "wb.h"
 // =================================================================================================================================
 
 
@@ -37,6 +46,44 @@
 #define DEFAULT_REAL_MEMORY_SIZE   (MB(4) + KB(16)) //WAS MB(5)
 #define PAGESIZE                   KB(4)
 #define PT_AREA_SIZE               (MB(4) + KB(4))
+#define DEFAULT_SLOW_MEMORY_SIZE   0
+#define DEFAULT_FAST_LATENCY       100
+#define DEFAULT_SLOW_LATENCY       300
+#define TIER_SCAN_BATCH            16
+#define HOT_HISTORY_MASK           0xc0
+#define MAX_PREFETCH               16
+#define PT_ENTRIES                 (PAGESIZE / sizeof(pt_entry_t))
+#define PREFAULT_BATCH             256
+#define STREAM_BATCH               64
+#define DEFAULT_RECLAIM_BATCH      64
+#define DEFAULT_RECLAIM_AGE        8
+#define MAX_SPACES                 16
+#define SHADOW_ENTRIES             65536
+#define DEFAULT_LOAD_WINDOW        10000
+#define DEFAULT_THRASH_THRESHOLD   20
+#define DEFAULT_RESUME_THRESHOLD   5
+#define DEFAULT_MIN_SUSPENSION     4
+#define PREPAGE_BATCH              64
+#define LOCAL_DISTANCE             10
+#define DEFAULT_REMOTE_DISTANCE    20
+#define DEFAULT_BALANCE_INTERVAL   64
+#define NO_FRAME                   UINT64_MAX
+#define DEFAULT_PAGE_COLORS        128
+#define MAX_PAGE_COLORS            (PAGESIZE / sizeof(pt_entry_t))
+#define ANY_COLOR                  (-1)
+#define COLORING_NONE              0
+#define COLORING_SPACE             1
+#define COLORING_VIRTUAL           2
+#define DEFAULT_COMPACT_PAGES      64
+#define MAX_COPIES                 64
+#define COPY_CHUNK_PAGES           16
+#define CLASS_OF_FLAGS(flags)      ((((flags) >> 4) & 0x7) - 1)
+#define RING_COUNT                 (MAX_SPACES * VMSIM_QOS_CLASSES)
+#define ALL_SPACES                 ((1u << MAX_SPACES) - 1)
+#define DEFAULT_PFF_UPPER          20
+#define DEFAULT_PFF_LOWER          5
+#define DEFAULT_PFF_STEP           8
+#define DEFAULT_PFF_MIN            8
 
 #define OFFSET_MASK           (PAGESIZE - 1)
 #define PAGE_NUMBER_MASK      (~OFFSET_MASK)
@@ -47,12 +94,17 @@
 #define IS_ALIGNED(addr)      ((addr & OFFSET_MASK) == 0)
 
 #define IS_RESIDENT(pte)      (pte & PTE_RESIDENT_BIT)
-#define IS_REFERENCED(pte)    (pte & PTE_REFERENCED_BIT)
+#define IS_REFERENCED(pte)    (pte & (PTE_REFERENCED_BIT | PTE_YOUNG_BIT))
 #define IS_DIRTY(pte)         (pte & PTE_DIRTY_BIT)
 #define SET_RESIDENT(pte)     (pte |= PTE_RESIDENT_BIT)
+#define SET_DIRTY(pte)        (pte |= PTE_DIRTY_BIT)
+#define SET_REFERENCED(pte)   (pte |= PTE_REFERENCED_BIT)
 #define CLEAR_RESIDENT(pte)   (pte &= ~PTE_RESIDENT_BIT)
-#define CLEAR_REFERENCED(pte) (pte &= ~PTE_REFERENCED_BIT)
+#define CLEAR_REFERENCED(pte) (pte &= ~(PTE_REFERENCED_BIT | PTE_YOUNG_BIT))
 #define CLEAR_DIRTY(pte)      (pte &= ~PTE_DIRTY_BIT)
+#define IS_ACTIVE(pte)        (pte & PTE_ACTIVE_BIT)
+#define SET_ACTIVE(pte)       (pte |= PTE_ACTIVE_BIT)
+#define CLEAR_ACTIVE(pte)     (pte &= ~PTE_ACTIVE_BIT)
 
 // The boundaries and size of the real memory region.
 static void*        real_base      = NULL;
@@ -68,12 +120,13 @@ static vmsim_addr_t real_free_addr = PT_AREA_SIZE;
 // The base real address of the upper page table.
 static vmsim_addr_t upper_pt       = 0;
 
+// The upper index covered by each lower table, by the table's page number in the page table area, so that a lower PTE leads back
+// to the _simulated_ page it maps.
+static uint16_t     pt_upper_indices[PT_AREA_SIZE / PAGESIZE];
+
 // Used by the heap allocator, the address of the next free simulated address.
 static vmsim_addr_t sim_free_addr  = 0;
 
-// The highest available block number on bs
-static unsigned int block_no 	   = 1;
-
 // The array of lpt entries, used in the CLOCK algorithm
 static uint64_t ENTRIES_LENGTH = (DEFAULT_REAL_MEMORY_SIZE - PT_AREA_SIZE) / PAGESIZE;
 static pt_entry_t** entries = NULL;
@@ -82,6 +135,201 @@ static uint64_t cur_page_no = 0;
 // The index of the first unused real page in MM, used to initialize entries in "entries"
 //static uint64_t page_no = 0;
 
+// The real memory tiers.  Frames [0, fast_frames) form the fast tier; the remaining frames, if any, form the slow tier, which is
+// filled from its own bump pointer and swept by its own clock hand.  The latencies are the simulated cost (ns) of one access.
+// `displacing` is the fast-tier frame whose page is being demoted, which no promotion made to free a slow frame may take.
+static uint64_t     slow_size      = DEFAULT_SLOW_MEMORY_SIZE;
+static uint64_t     fast_frames    = 0;
+static vmsim_addr_t slow_free_addr = 0;
+static uint64_t     slow_page_no   = 0;
+static uint64_t     scan_page_no   = 0;
+static uint64_t     displacing     = NO_FRAME;
+static uint64_t     fast_latency   = DEFAULT_FAST_LATENCY;
+static uint64_t     slow_latency   = DEFAULT_SLOW_LATENCY;
+static vmsim_tier_stats_t tier_stats;
+
+// The block that still holds a valid copy of each frame's page, if any, so that clean pages need not be written again.
+static unsigned int* frame_blocks = NULL;
+
+// Whether each frame holds a prefetched page that has not yet been referenced, and whether prefetching is enabled at all.
+static bool*    prefetched   = NULL;
+static bool     prefetching  = false;
+
+// The reference-bit history of each frame, shifted right on every CLOCK visit with the newest sample in the high bit.
+static uint8_t* histories = NULL;
+
+// The number of pages, in an aligned window around a first-touch fault, to map in one pass (1 maps only the faulting page).
+static uint64_t fault_around = 1;
+static vmsim_fault_stats_t fault_stats;
+
+// Whether the region-based access monitor is sampling reference bits.
+static bool     monitoring   = false;
+
+// Whether accesses are followed through the model of the CPU's caches and TLBs.
+static bool     cache_modeling = false;
+
+// Proactive reclaim:  every `reclaim_interval` accesses (0 disables it), the reclaimer harvests the reference bits of the next
+// `reclaim_batch` evictable frames, ageing those that were idle, and evicts any page idle for `reclaim_age` consecutive passes.
+static uint64_t  reclaim_interval = 0;
+static uint64_t  reclaim_batch    = DEFAULT_RECLAIM_BATCH;
+static uint64_t  reclaim_age      = DEFAULT_RECLAIM_AGE;
+static uint64_t  reclaim_ticks    = 0;
+static uint64_t  reclaim_hand     = 0;
+static uint16_t* idle_ages        = NULL;
+static vmsim_reclaim_stats_t reclaim_stats;
+
+// Unowned frames below the bump pointers, freed by reclaim or suspension, which each tier's allocator hands out before evicting
+// anything.  The fast tier's frames are pooled in bins, one per NUMA node and page color, each stacking up from its own first slot
+// in the pool; the slow tier's stack down from the top.  With more than one bin, every frame starts out pooled, and the bottom
+// `bin_fresh` frames of each bin have never been used.  `bin_pins` counts the frames of each bin pinned by copies.
+static uint64_t* free_pool        = NULL;
+static int       bin_count        = 1;
+static uint64_t* bin_firsts       = NULL;
+static uint64_t* bin_counts       = NULL;
+static uint64_t* bin_fresh        = NULL;
+static uint64_t* bin_hands        = NULL;
+static uint64_t* bin_pins         = NULL;
+static uint64_t  slow_pool_count  = 0;
+
+// NUMA:  the fast tier is split evenly into `numa_nodes` nodes, node `n` holding the frames from `node_first(n)`.  Each thread has
+// a home node, from which its accesses are made at a cost scaled by the distance to the frame's node.
+static int       numa_nodes       = 1;
+static uint64_t  numa_distances[VMSIM_MAX_NODES][VMSIM_MAX_NODES];
+static int       numa_policy      = VMSIM_NUMA_FIRST_TOUCH;
+static int       bind_node        = 0;
+static int       interleave_node  = 0;
+static uint64_t  node_hands[VMSIM_MAX_NODES];
+static __thread int home_node     = 0;
+
+// Page coloring:  the color of a frame is its page number modulo `page_colors`, the real-address bits that select a slice of the
+// last-level cache's sets.  When coloring, each new page gets a color from its space's range of colors, either round-robin or by
+// its virtual page number, and comes from, or displaces a page in, a frame of that color.
+static int       coloring         = COLORING_NONE;
+static int       page_colors      = 1;
+
+// Automatic NUMA balancing:  every `balance_interval` accesses, one is sampled as a hinting fault, and the node it came from is
+// recorded against the frame.  A page sampled twice in a row from the same remote node is moved there.
+static bool      numa_balancing   = false;
+static uint64_t  balance_interval = DEFAULT_BALANCE_INTERVAL;
+static uint64_t  balance_ticks    = 0;
+static uint8_t*  hint_nodes       = NULL;
+static vmsim_numa_stats_t numa_stats;
+
+// Frame compaction:  every `compact_interval` accesses (0 disables it), the background compactor visits the next node, and builds a
+// run of `compact_pages` free frames there if the node has that many free frames but no such run.  While a run is being built, the
+// slow tier promotes nothing, so that no promoted page lands in, or displaces a page from, a frame of the run.
+static uint64_t  compact_interval = 0;
+static uint64_t  compact_pages    = DEFAULT_COMPACT_PAGES;
+static uint64_t  compact_ticks    = 0;
+static int       compact_next     = 0;
+static bool      compacting       = false;
+static vmsim_compaction_stats_t compaction_stats;
+
+// Asynchronous copies:  each is cut into chunks, whose pages are faulted in and pinned by the caller's thread, then copied frame to
+// frame by the copy engine's helper thread.  A pinned frame is never chosen for eviction, demotion, promotion or migration.  No
+// more than `max_pinned` frames, a quarter of the fast tier, are pinned at once, so that some node always has a frame to give up.
+// A bin or node may still be pinned whole, and a fault that would displace a page there takes its frame from elsewhere.
+typedef struct {
+  bool         in_use;
+  bool         pending;
+  int          space;
+  vmsim_addr_t dst;
+  vmsim_addr_t src;
+  size_t       len;
+  size_t       issued;
+  uint64_t     ticket;
+  size_t       pinned_count;
+  uint64_t     pinned[4 * COPY_CHUNK_PAGES];
+} copy_t;
+static copy_t    copies[MAX_COPIES];
+static int       active_copies    = 0;
+static uint16_t* pins             = NULL;
+static uint64_t  pinned_frames    = 0;
+static uint64_t  max_pinned       = 0;
+static vmsim_copy_stats_t copy_stats;
+
+// QoS classes:  each page belongs to the class of the newest tag covering it, or to `VMSIM_QOS_NORMAL`.  The fast-tier
+// frames holding one space's pages of one class form a doubly linked ring, numbered `(space * VMSIM_QOS_CLASSES) + class` and
+// swept by its own CLOCK hand; `class_next` is `NO_FRAME` for a frame in no ring, and `frame_rings` records the ring of each frame
+// in one.  Once a range is tagged, or under local replacement, and while there is only one bin, a victim is chosen from the rings
+// rather than by the global hand.  A class's rings are taken in turn, each for a lap's worth of victims, as one hand would sweep
+// all of the class's frames.
+static bool      qos_active        = false;
+static uint8_t*  frame_classes     = NULL;
+static uint64_t* class_next        = NULL;
+static uint64_t* class_prev        = NULL;
+static uint8_t*  frame_rings       = NULL;
+static uint64_t  ring_hands[RING_COUNT];
+static uint64_t  ring_frames[RING_COUNT];
+static uint64_t  class_frames[VMSIM_QOS_CLASSES];
+static uint64_t  class_reserves[VMSIM_QOS_CLASSES];
+static int       class_turns[VMSIM_QOS_CLASSES];
+static uint64_t  class_turn_left[VMSIM_QOS_CLASSES];
+static vmsim_qos_stats_t qos_stats;
+
+// Replacement scope:  under global replacement, the default, a fault may displace any space's page.  Under local replacement, each
+// space holds at most its allotment of fast-tier frames:  a space at its allotment displaces one of its own pages, and one below it
+// takes a free frame, or failing that one from a space above its own allotment.  When `pff_control` is set, at the end of every
+// load-control window the page-fault-frequency controller takes `pff_step` frames from the allotment of each space that faulted
+// fewer than `pff_lower` times per thousand accesses, down to `pff_min`, and gives as many more, while any frames are unallotted,
+// to each that faulted more than `pff_upper` times.
+static bool      local_replacement = false;
+static bool      pff_control       = false;
+static uint64_t  pff_upper         = DEFAULT_PFF_UPPER;
+static uint64_t  pff_lower         = DEFAULT_PFF_LOWER;
+static uint64_t  pff_step          = DEFAULT_PFF_STEP;
+static uint64_t  pff_min           = DEFAULT_PFF_MIN;
+
+// The address spaces.  Each has its own upper page table and allocator; the globals `upper_pt` and `sim_free_addr` belong to the
+// current one.  Every frame records the space that owns its page.  The QoS classes of a space's pages are kept in tables shaped
+// like its lower page tables, one per upper index that has had a page tagged.
+typedef struct {
+  bool                created;
+  vmsim_addr_t        upper_pt;
+  vmsim_addr_t        sim_free_addr;
+  uint8_t*            class_tables[PT_ENTRIES];
+  uint64_t            window_accesses;
+  uint64_t            window_faults;
+  uint64_t            window_refaults;
+  uint64_t            suspended_windows;
+  vmsim_addr_t*       working_set;
+  uint64_t            working_set_size;
+  int                 color_first;
+  int                 color_count;
+  int                 color_next;
+  int                 copies;
+  vmsim_space_stats_t stats;
+} space_t;
+static space_t   spaces[MAX_SPACES];
+static int       current_space    = 0;
+static uint8_t*  owners           = NULL;
+
+// Shadow entries:  the eviction clock reading at which each recently evicted page left memory, indexed by the real address of its
+// lower PTE, so that a refault can tell how many evictions it missed by.
+typedef struct {
+  vmsim_addr_t lower_pte_addr;
+  uint64_t     evicted_at;
+} shadow_t;
+static shadow_t  shadows[SHADOW_ENTRIES];
+static uint64_t  eviction_clock   = 0;
+
+// Whether a refault within a real memory's worth of evictions activates the page, and the distribution of refault distances.
+static bool      refault_activate = false;
+static vmsim_refault_stats_t refault_stats;
+
+// Load control:  every `load_window` accesses, the refaults of all spaces are totalled.  At `thrash_threshold` or more refaults per
+// thousand accesses, the lowest-priority running space is suspended and its frames given to the rest; at `resume_threshold` or
+// fewer, the highest-priority space that has been suspended for at least `min_suspension` windows is resumed.
+static bool      load_control     = false;
+static uint64_t  load_window      = DEFAULT_LOAD_WINDOW;
+static uint64_t  load_ticks       = 0;
+static uint64_t  thrash_threshold = DEFAULT_THRASH_THRESHOLD;
+static uint64_t  resume_threshold = DEFAULT_RESUME_THRESHOLD;
+static uint64_t  min_suspension   = DEFAULT_MIN_SUSPENSION;
+
+// Whether a resumed space has the working set recorded at its suspension swapped back in at once.
+static bool      prepaging        = true;
+
 //DEBUG: store last created pte
 static pt_entry_t* last_pte = 0x0;
 
@@ -89,269 +337,3681 @@ static pt_entry_t* last_pte = 0x0;
 static bool overflowed = false;
 // =================================================================================================================================
 
-// =============
-//Declare my functions because this is C
-vmsim_addr_t move_to_bs(pt_entry_t* lpt_entry);
-void move_to_mm(pt_entry_t lpt_entry, vmsim_addr_t real_addr);
-void swap(vmsim_addr_t in, pt_entry_t* out);
-pt_entry_t* search();
-uint64_t get_page_no(vmsim_addr_t real_addr);
-void show_entries();
-vmsim_addr_t get_real_address(pt_entry_t* lpte_pt);
-// =============
+// =============
+//Declare my functions because this is C
+vmsim_addr_t move_to_bs(pt_entry_t* lpt_entry);
+vmsim_addr_t release_to_pager(pt_entry_t* lpt_entry, int pager, vmsim_addr_t page);
+void move_to_mm(pt_entry_t lpt_entry, vmsim_addr_t real_addr);
+void install_page(vmsim_addr_t lpt_entry_ra, vmsim_addr_t real_addr, int space);
+uint64_t search_range(uint64_t* hand, uint64_t first, uint64_t count);
+uint64_t search_stride(uint64_t* hand, uint64_t first, uint64_t count, uint64_t stride);
+uint64_t node_victim(int node, int color);
+uint64_t ring_victim(uint32_t spaces_mask);
+uint64_t get_page_no(vmsim_addr_t real_addr);
+void show_entries();
+vmsim_addr_t get_real_address(pt_entry_t* lpte_pt);
+vmsim_addr_t lookup_lower_pte(vmsim_addr_t sim_addr);
+vmsim_addr_t space_lower_pte(int space, vmsim_addr_t sim_addr, bool create);
+void evict_frame(uint64_t page_no);
+void pool_frame(uint64_t page_no);
+void remember_eviction(vmsim_addr_t lower_pte_addr);
+// =============
+
+// =================================================================================================================================
+/**
+ * Allocate a page of real memory space for a page table block.  Taken from a region of real memory reserved for this purpose.
+ *
+ * \return The _real_ base address of a page of memory for a page table block.
+ */
+vmsim_addr_t
+allocate_pt () {
+
+  vmsim_addr_t new_pt_addr = pt_free_addr;
+  pt_free_addr += PAGESIZE;
+  assert(IS_ALIGNED(new_pt_addr));
+  assert(pt_free_addr <= PT_AREA_SIZE);
+  void* new_pt_ptr = (void*)(real_base + new_pt_addr);
+  memset(new_pt_ptr, 0, PAGESIZE);
+  
+  return new_pt_addr;
+  
+} // allocate_pt ()
+
+
+
+/**
+ * Allocate a lower table, recording the _simulated_ range it covers.
+ *
+ * \param  sim_addr A _simulated_ address that the table covers.
+ * \return the _real_ base address of the table.
+ */
+vmsim_addr_t
+allocate_lower_pt (vmsim_addr_t sim_addr) {
+
+  vmsim_addr_t lower_pt = allocate_pt();
+  pt_upper_indices[lower_pt / PAGESIZE] = GET_UPPER_INDEX(sim_addr);
+  return lower_pt;
+
+} // allocate_lower_pt ()
+
+
+
+/**
+ * \return the _simulated_ base address of the page mapped by the lower PTE at a _real_ address.
+ */
+vmsim_addr_t
+pte_page_addr (vmsim_addr_t lower_pte_addr) {
+
+  return (((vmsim_addr_t)pt_upper_indices[lower_pte_addr / PAGESIZE] << 22) |
+          (((lower_pte_addr & OFFSET_MASK) / sizeof(pt_entry_t)) << 12));
+
+} // pte_page_addr ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Drop the modelled TLB entry for the page held in a frame, whose translation is about to change or go away.
+ *
+ * \param page_no The number of a frame that holds a page.
+ */
+void
+invalidate_translation (uint64_t page_no) {
+
+  if (cache_modeling) {
+    cm_invalidate(owners[page_no], pte_page_addr(get_real_address(entries[page_no])));
+  }
+
+} // invalidate_translation ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Read an unsigned integer from an environment variable.
+ *
+ * \param  name          The name of the environment variable.
+ * \param  default_value The value to use if the variable is not set.
+ * \return the value of the variable, or `default_value` if it is not set.
+ */
+uint64_t
+getenv_u64 (const char* name, uint64_t default_value) {
+
+  char* envvar = getenv(name);
+  if (envvar == NULL) {
+    return default_value;
+  }
+  errno = 0;
+  uint64_t value = strtoull(envvar, NULL, 10);
+  assert(errno == 0);
+  return value;
+
+} // getenv_u64 ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \return the _real_ base address of the given frame.
+ */
+static inline vmsim_addr_t
+frame_addr (uint64_t page_no) {
+
+  return PT_AREA_SIZE + (page_no * PAGESIZE);
+
+} // frame_addr ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \return the number of the first fast-tier frame on the given node, or `fast_frames` for the node past the last.
+ */
+static inline uint64_t
+node_first (int node) {
+
+  return (((uint64_t)node * fast_frames) + numa_nodes - 1) / numa_nodes;
+
+} // node_first ()
+
+
+
+/**
+ * \return the node holding the given fast-tier frame.
+ */
+static inline int
+node_of (uint64_t page_no) {
+
+  return (page_no * numa_nodes) / fast_frames;
+
+} // node_of ()
+
+
+
+/**
+ * \return the page color of the given frame.
+ */
+static inline int
+color_of (uint64_t page_no) {
+
+  return (frame_addr(page_no) / PAGESIZE) % page_colors;
+
+} // color_of ()
+
+
+
+/**
+ * \return the pool bin for the given fast-tier frame.
+ */
+static inline int
+bin_of (uint64_t page_no) {
+
+  return (node_of(page_no) * page_colors) + color_of(page_no);
+
+} // bin_of ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \return the QoS class of a page:  that of the newest tag covering it, or `VMSIM_QOS_NORMAL`.
+ *
+ * \param space    The space to which the page belongs.
+ * \param sim_addr The _simulated_ base address of the page.
+ */
+int
+page_class (int space, vmsim_addr_t sim_addr) {
+
+  uint8_t* classes = spaces[space].class_tables[GET_UPPER_INDEX(sim_addr)];
+  return (classes != NULL) ? classes[GET_LOWER_INDEX(sim_addr)] : VMSIM_QOS_NORMAL;
+
+} // page_class ()
+
+
+
+/**
+ * Add a frame that holds a page to the ring of its owner and class, just behind the ring's hand so that it is the last to be
+ * visited, if it is in the fast tier.
+ *
+ * \param page_no The frame number.
+ */
+void
+class_link (uint64_t page_no) {
+
+  if (page_no >= fast_frames) {
+    return;
+  }
+  int ring = (owners[page_no] * VMSIM_QOS_CLASSES) + frame_classes[page_no];
+  if (ring_frames[ring] == 0) {
+    class_next[page_no] = page_no;
+    class_prev[page_no] = page_no;
+    ring_hands[ring]    = page_no;
+  } else {
+    uint64_t hand                = ring_hands[ring];
+    class_next[page_no]          = hand;
+    class_prev[page_no]          = class_prev[hand];
+    class_next[class_prev[hand]] = page_no;
+    class_prev[hand]             = page_no;
+  }
+  frame_rings[page_no]                  = ring;
+  ring_frames[ring]                    += 1;
+  class_frames[frame_classes[page_no]] += 1;
+
+} // class_link ()
+
+
+
+/**
+ * Remove a frame from its ring, if it is in one, moving the ring's hand past it.
+ *
+ * \param page_no The frame number.
+ */
+void
+class_unlink (uint64_t page_no) {
+
+  if (class_next[page_no] == NO_FRAME) {
+    return;
+  }
+  int ring = frame_rings[page_no];
+  if (ring_hands[ring] == page_no) {
+    ring_hands[ring] = class_next[page_no];
+  }
+  class_next[class_prev[page_no]]       = class_next[page_no];
+  class_prev[class_next[page_no]]       = class_prev[page_no];
+  class_next[page_no]                   = NO_FRAME;
+  ring_frames[ring]                    -= 1;
+  class_frames[ring % VMSIM_QOS_CLASSES] -= 1;
+
+} // class_unlink ()
+
+
+
+/**
+ * \return the number of fast-tier frames holding a space's pages.
+ */
+uint64_t
+space_frames (int space) {
+
+  uint64_t frames = 0;
+  for (int i = 0; i < VMSIM_QOS_CLASSES; i += 1) {
+    frames += ring_frames[(space * VMSIM_QOS_CLASSES) + i];
+  }
+  return frames;
+
+} // space_frames ()
+
+
+
+/**
+ * Rebuild every ring from the frame table, after the tiers have been resized.
+ */
+void
+rebuild_class_rings () {
+
+  for (int i = 0; i < RING_COUNT; i += 1) {
+    ring_frames[i] = 0;
+  }
+  for (int i = 0; i < VMSIM_QOS_CLASSES; i += 1) {
+    class_frames[i] = 0;
+  }
+  for (uint64_t i = 0; i < ENTRIES_LENGTH; i += 1) {
+    class_next[i] = NO_FRAME;
+    if (entries[i] != NULL) {
+      class_link(i);
+    }
+  }
+
+} // rebuild_class_rings ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Move the page held in one frame into another, free frame, updating its lower PTE and the frame table.  The source frame is left
+ * unowned and is not cleared.
+ *
+ * \param from The frame number currently holding the page.
+ * \param to   The frame number of a free frame to receive the page.
+ */
+void
+migrate_page (uint64_t from, uint64_t to) {
+
+  pt_entry_t* lpte_ptr = entries[from];
+  assert(lpte_ptr != NULL);
+  pg_complete_fill(real_base + frame_addr(from));
+  invalidate_translation(from);
+  // A page demoted to the slow tier is cold, so it should not displace anything from the host's caches on the way.
+  (to >= fast_frames ? pc_stream : pc_copy)(real_base + frame_addr(to), real_base + frame_addr(from));
+
+  pt_entry_t lpte = (*lpte_ptr & OFFSET_MASK) | frame_addr(to);
+  vmsim_write_real(&lpte, get_real_address(lpte_ptr), sizeof(pt_entry_t));
+  entries[to]        = lpte_ptr;
+  histories[to]      = histories[from];
+  frame_blocks[to]   = frame_blocks[from];
+  prefetched[to]     = prefetched[from];
+  idle_ages[to]      = idle_ages[from];
+  owners[to]         = owners[from];
+  hint_nodes[to]     = hint_nodes[from];
+  entries[from]      = NULL;
+  frame_blocks[from] = 0;
+  class_unlink(from);
+  frame_classes[to]  = frame_classes[from];
+  class_link(to);
+  
+} // migrate_page ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Exchange the pages held in two frames, updating both lower PTEs and the frame table.
+ *
+ * \param a The frame number of one page.
+ * \param b The frame number of the other page.
+ */
+void
+exchange_pages (uint64_t a, uint64_t b) {
+
+  static uint8_t buffer[PAGESIZE] __attribute__((aligned(PAGESIZE)));
+  void* a_ptr = real_base + frame_addr(a);
+  void* b_ptr = real_base + frame_addr(b);
+  pg_complete_fill(a_ptr);
+  pg_complete_fill(b_ptr);
+  invalidate_translation(a);
+  invalidate_translation(b);
+  pc_copy(buffer, a_ptr);
+  pc_copy(a_ptr, b_ptr);
+  pc_copy(b_ptr, buffer);
+
+  pt_entry_t a_lpte = (*entries[b] & OFFSET_MASK) | frame_addr(a);
+  pt_entry_t b_lpte = (*entries[a] & OFFSET_MASK) | frame_addr(b);
+  vmsim_write_real(&a_lpte, get_real_address(entries[b]), sizeof(pt_entry_t));
+  vmsim_write_real(&b_lpte, get_real_address(entries[a]), sizeof(pt_entry_t));
+
+  pt_entry_t* lpte_ptr = entries[a];
+  entries[a]           = entries[b];
+  entries[b]           = lpte_ptr;
+  uint8_t history      = histories[a];
+  histories[a]         = histories[b];
+  histories[b]         = history;
+  unsigned int block   = frame_blocks[a];
+  frame_blocks[a]      = frame_blocks[b];
+  frame_blocks[b]      = block;
+  bool pending         = prefetched[a];
+  prefetched[a]        = prefetched[b];
+  prefetched[b]        = pending;
+  uint16_t age         = idle_ages[a];
+  idle_ages[a]         = idle_ages[b];
+  idle_ages[b]         = age;
+  uint8_t owner        = owners[a];
+  owners[a]            = owners[b];
+  owners[b]            = owner;
+  uint8_t hint         = hint_nodes[a];
+  hint_nodes[a]        = hint_nodes[b];
+  hint_nodes[b]        = hint;
+  class_unlink(a);
+  class_unlink(b);
+  uint8_t qos_class    = frame_classes[a];
+  frame_classes[a]     = frame_classes[b];
+  frame_classes[b]     = qos_class;
+  class_link(a);
+  class_link(b);
+  
+} // exchange_pages ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Account for a frame's prefetched page, if it has one, now that its reference bit has been sampled.
+ *
+ * \param page_no    The frame number.
+ * \param referenced Whether the page was referenced.
+ */
+static inline void
+resolve_prefetch (uint64_t page_no, bool referenced) {
+
+  if (prefetched[page_no]) {
+    prefetched[page_no] = false;
+    pf_resolve(referenced);
+  }
+
+} // resolve_prefetch ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Pool an unowned frame below the bump pointers, for its tier's allocator to hand out before evicting anything.
+ *
+ * \param page_no The number of the frame.
+ */
+void
+pool_frame (uint64_t page_no) {
+
+  if (page_no < fast_frames) {
+    int bin = bin_of(page_no);
+    free_pool[bin_firsts[bin] + bin_counts[bin]++] = page_no;
+  } else {
+    slow_pool_count += 1;
+    free_pool[ENTRIES_LENGTH - slow_pool_count] = page_no;
+  }
+
+} // pool_frame ()
+
+
+
+/**
+ * \return the number of frames, pooled or not, in the given bin.
+ */
+static inline uint64_t
+bin_size (int bin) {
+
+  return ((bin + 1 < bin_count) ? bin_firsts[bin + 1] : fast_frames) - bin_firsts[bin];
+
+} // bin_size ()
+
+
+
+/**
+ * \return a bin of the given node that holds pooled frames of the given color, or of any color for `ANY_COLOR`; or -1 if none does.
+ */
+int
+pooled_bin (int node, int color) {
+
+  for (int c = (color == ANY_COLOR) ? 0 : color; c < page_colors && (c == color || color == ANY_COLOR); c += 1) {
+    if (bin_counts[(node * page_colors) + c] > 0) {
+      return (node * page_colors) + c;
+    }
+  }
+  return -1;
+
+} // pooled_bin ()
+
+
+
+/**
+ * \return whether copies have pinned every frame of a node of a color, or of any color for `ANY_COLOR`.
+ */
+bool
+bin_pinned (int node, int color) {
+
+  for (int c = (color == ANY_COLOR) ? 0 : color; c < page_colors && (c == color || color == ANY_COLOR); c += 1) {
+    if (bin_pins[(node * page_colors) + c] < bin_size((node * page_colors) + c)) {
+      return false;
+    }
+  }
+  return true;
+
+} // bin_pinned ()
+
+
+
+/**
+ * Take a pooled fast-tier frame of a color from a node, or failing that, if allowed, from the nearest node that has one.
+ *
+ * \param  node     The preferred node.
+ * \param  color    The color required, or `ANY_COLOR`.
+ * \param  fallback Whether another node may supply the frame.
+ * \return the number of the frame, or `NO_FRAME` if there is none.
+ */
+uint64_t
+take_pooled_frame (int node, int color, bool fallback) {
+
+  int chosen = node;
+  int bin    = pooled_bin(node, color);
+  for (int n = 0; fallback && bin < 0 && n < numa_nodes; n += 1) {
+    int candidate = pooled_bin(n, color);
+    if (candidate >= 0 && (bin < 0 || numa_distances[node][n] < numa_distances[node][chosen])) {
+      chosen = n;
+      bin    = candidate;
+    }
+  }
+  if (bin < 0) {
+    return NO_FRAME;
+  }
+  if (chosen != node) {
+    numa_stats.fallbacks += 1;
+  }
+
+  // Frames that have never been used lie at the bottom of each bin, and are not counted as reuse.
+  bin_counts[bin] -= 1;
+  if (bin_counts[bin] < bin_fresh[bin]) {
+    bin_fresh[bin] = bin_counts[bin];
+  } else {
+    reclaim_stats.pool_hits += 1;
+  }
+  return free_pool[bin_firsts[bin] + bin_counts[bin]];
+
+} // take_pooled_frame ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Record the eviction of a page in its shadow entry, advancing the eviction clock.
+ *
+ * \param lower_pte_addr The _real_ address of the page's lower PTE.
+ */
+void
+remember_eviction (vmsim_addr_t lower_pte_addr) {
+
+  eviction_clock += 1;
+  shadow_t* shadow       = &shadows[(lower_pte_addr / sizeof(pt_entry_t)) % SHADOW_ENTRIES];
+  shadow->lower_pte_addr = lower_pte_addr;
+  shadow->evicted_at     = eviction_clock;
+
+} // remember_eviction ()
+
+
+
+/**
+ * Look up and drop the shadow entry of a page, if it has not been overwritten by another page's.
+ *
+ * \param  lower_pte_addr The _real_ address of the page's lower PTE.
+ * \param  distance       Where to store the number of evictions since the page's own.
+ * \return whether the page had a shadow entry.
+ */
+bool
+recall_eviction (vmsim_addr_t lower_pte_addr, uint64_t* distance) {
+
+  shadow_t* shadow = &shadows[(lower_pte_addr / sizeof(pt_entry_t)) % SHADOW_ENTRIES];
+  if (shadow->lower_pte_addr != lower_pte_addr || shadow->evicted_at == 0) {
+    return false;
+  }
+  *distance          = eviction_clock - shadow->evicted_at;
+  shadow->evicted_at = 0;
+  return true;
+
+} // recall_eviction ()
+
+
+
+/**
+ * Account for a page swapped back in by a fault in the current space, recording its refault distance.  It counts as a refault of
+ * its space when it was evicted less than a real memory's worth of evictions ago:  it would have stayed resident had it only been
+ * kept over pages that were not reused, so its space's working set does not fit.  Such a page is activated if enabled, so that
+ * CLOCK passes it over once more than an ordinary page.
+ *
+ * \param lower_pte_addr The _real_ address of the page's lower PTE, which must be resident.
+ */
+void
+account_refault (vmsim_addr_t lower_pte_addr) {
+
+  uint64_t distance;
+  if (!recall_eviction(lower_pte_addr, &distance)) {
+    refault_stats.untracked += 1;
+    return;
+  }
+
+  unsigned int bucket = 0;
+  while (bucket < VMSIM_REFAULT_BUCKETS - 1 && (distance >> bucket) != 0) {
+    bucket += 1;
+  }
+  refault_stats.histogram[bucket] += 1;
+  refault_stats.refaults          += 1;
+
+  if (distance <= ENTRIES_LENGTH) {
+    spaces[current_space].stats.refaults  += 1;
+    spaces[current_space].window_refaults += 1;
+    if (refault_activate) {
+      pt_entry_t lower_pte;
+      vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+      SET_ACTIVE(lower_pte);
+      vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+      refault_stats.activations += 1;
+    }
+  }
+
+} // account_refault ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Sample the reference bit of one slow-tier frame into its history, and promote the page to the fast tier if it has been referenced
+ * on each of its recent samples.  The page trades places with a fast-tier page of its own space if local replacement holds the
+ * space to its allotment, and otherwise goes to a free fast-tier frame if there is one, or trades places with the page that a fault
+ * would displace.
+ *
+ * \param  page_no The number of a slow-tier frame that holds a page.
+ * \return whether the page had been referenced since its last sample.
+ */
+bool
+sample_slow_page (uint64_t page_no) {
+
+  pt_entry_t lpte       = *entries[page_no];
+  bool       referenced = IS_REFERENCED(lpte);
+  histories[page_no] = (histories[page_no] >> 1) | (referenced ? 0x80 : 0);
+  resolve_prefetch(page_no, referenced);
+  if (!referenced && IS_ACTIVE(lpte)) {
+    CLEAR_ACTIVE(lpte);
+    vmsim_write_real(&lpte, get_real_address(entries[page_no]), sizeof(pt_entry_t));
+    return true;
+  }
+  if (!referenced) {
+    return false;
+  }
+  CLEAR_REFERENCED(lpte);
+  vmsim_write_real(&lpte, get_real_address(entries[page_no]), sizeof(pt_entry_t));
+
+  bool hot = ((histories[page_no] & HOT_HISTORY_MASK) == HOT_HISTORY_MASK);
+  if (!hot || compacting) {
+    return true;
+  }
+  int      space  = owners[page_no];
+  uint64_t victim = NO_FRAME;
+  if (local_replacement && bin_count == 1 && space_frames(space) >= spaces[space].stats.allotment) {
+    victim = ring_victim(1u << space);
+  }
+  uint64_t to = (victim == NO_FRAME) ? take_pooled_frame(home_node, ANY_COLOR, true) : NO_FRAME;
+  if (victim == NO_FRAME && to == NO_FRAME && real_free_addr < frame_addr(fast_frames)) {
+    to              = get_page_no(real_free_addr);
+    real_free_addr += PAGESIZE;
+  }
+  if (to != NO_FRAME) {
+    migrate_page(page_no, to);
+    pool_frame(page_no);
+    tier_stats.promotions += 1;
+    return true;
+  }
+
+  // The page trades places, unless copies have pinned every frame it could take, or the page it would displace is already on its
+  // way down.
+  if (victim == NO_FRAME && bin_count > 1 && bin_pinned(home_node, ANY_COLOR)) {
+    return true;
+  }
+  if (victim == NO_FRAME) {
+    victim = node_victim(home_node, ANY_COLOR);
+  }
+  if (victim != displacing) {
+    exchange_pages(page_no, victim);
+    tier_stats.promotions += 1;
+    tier_stats.demotions  += 1;
+  }
+  return true;
+
+} // sample_slow_page ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Advance the promotion scanner over a small batch of slow-tier frames, so that hot pages are promoted even when the slow tier is
+ * not under replacement pressure.
+ */
+void
+scan_slow_tier () {
+
+  uint64_t slow_frames = (slow_free_addr - frame_addr(fast_frames)) / PAGESIZE;
+  if (real_free_addr < frame_addr(fast_frames) || slow_frames == 0) {
+    return;
+  }
+  for (uint64_t i = 0; i < TIER_SCAN_BATCH && i < slow_frames; i += 1) {
+    if (entries[fast_frames + scan_page_no] != NULL && pins[fast_frames + scan_page_no] == 0) {
+      sample_slow_page(fast_frames + scan_page_no);
+    }
+    scan_page_no = (scan_page_no + 1) % slow_frames;
+  }
+
+} // scan_slow_tier ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Obtain a free slow-tier frame, evicting the coldest slow-tier page to the backing store if the tier is full.  Hot pages met along
+ * the way are promoted instead of evicted.
+ *
+ * \return the frame number of a free slow-tier frame.
+ */
+uint64_t
+allocate_slow_page () {
+
+  if (slow_pool_count > 0) {
+    reclaim_stats.pool_hits += 1;
+    return free_pool[ENTRIES_LENGTH - slow_pool_count--];
+  }
+  if (slow_free_addr < frame_addr(ENTRIES_LENGTH)) {
+    vmsim_addr_t new_real_addr = slow_free_addr;
+    slow_free_addr += PAGESIZE;
+    return get_page_no(new_real_addr);
+  }
+
+  uint64_t slow_frames = ENTRIES_LENGTH - fast_frames;
+  while (true) {
+    uint64_t victim = fast_frames + slow_page_no;
+    slow_page_no = (slow_page_no + 1) % slow_frames;
+    if (entries[victim] == NULL || pins[victim] > 0) {
+      continue;
+    }
+    if (!sample_slow_page(victim)) {
+      move_to_bs(entries[victim]);
+      entries[victim] = NULL;
+      return victim;
+    }
+
+    // A promotion into a free fast-tier frame leaves its slow-tier frame free, so nothing need be evicted.
+    if (slow_pool_count > 0) {
+      reclaim_stats.pool_hits += 1;
+      return free_pool[ENTRIES_LENGTH - slow_pool_count--];
+    }
+  }
+
+} // allocate_slow_page ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \return the node on which the placement policy puts the next new page.
+ */
+int
+place_page () {
+
+  if (numa_policy == VMSIM_NUMA_BIND) {
+    return bind_node;
+  }
+  if (numa_policy == VMSIM_NUMA_INTERLEAVE) {
+    int node        = interleave_node;
+    interleave_node = (interleave_node + 1) % numa_nodes;
+    return node;
+  }
+  return home_node;
+
+} // place_page ()
+
+
+
+/**
+ * \return the color for a new page, given the real address of its lower PTE and the space to which it belongs, or `ANY_COLOR` when
+ *         not coloring.  Round-robin coloring skips colors with no pooled frame on the node while some color in the range has one.
+ */
+int
+choose_color (int node, vmsim_addr_t lower_pte_addr, int space) {
+
+  space_t* owner = &spaces[space];
+  if (coloring == COLORING_NONE) {
+    return ANY_COLOR;
+  }
+  if (coloring == COLORING_VIRTUAL) {
+    return owner->color_first + ((lower_pte_addr & OFFSET_MASK) / sizeof(pt_entry_t)) % owner->color_count;
+  }
+  int color = owner->color_first + owner->color_next;
+  for (int i = 0; i < owner->color_count; i += 1) {
+    int candidate = owner->color_first + ((owner->color_next + i) % owner->color_count);
+    if (bin_counts[(node * page_colors) + candidate] > 0) {
+      color = candidate;
+      break;
+    }
+  }
+  owner->color_next = (color - owner->color_first + 1) % owner->color_count;
+  return color;
+
+} // choose_color ()
+
+
+
+/**
+ * Sweep a ring with its CLOCK hand, as `search_stride()` sweeps frames, for a page that is neither pinned nor referenced.  Every
+ * page in the ring is visited at most three times:  to clear its reference bit, its active bit, and to take it.
+ *
+ * \return the frame number of the victim, or `NO_FRAME` if every page in the ring is pinned.
+ */
+uint64_t
+sweep_ring (int ring) {
+
+  uint64_t hand = ring_hands[ring];
+  for (uint64_t step = 0; step < 3 * ring_frames[ring]; step += 1) {
+    uint64_t frame   = hand;
+    hand             = class_next[frame];
+    qos_stats.steps += 1;
+    if (pins[frame] > 0) {
+      continue;
+    }
+    pt_entry_t lpte = *entries[frame];
+    if (IS_REFERENCED(lpte) || IS_ACTIVE(lpte)) {
+      bool referenced = IS_REFERENCED(lpte);
+      histories[frame] = (histories[frame] >> 1) | (referenced ? 0x80 : 0);
+      resolve_prefetch(frame, referenced);
+      pt_entry_t entry_no_ref = referenced ? CLEAR_REFERENCED(lpte) : CLEAR_ACTIVE(lpte);
+      vmsim_write_real(&entry_no_ref, get_real_address(entries[frame]), sizeof(pt_entry_t));
+      continue;
+    }
+    histories[frame] >>= 1;
+    resolve_prefetch(frame, false);
+    ring_hands[ring] = hand;
+    return frame;
+  }
+  ring_hands[ring] = hand;
+  return NO_FRAME;
+
+} // sweep_ring ()
+
+
+
+/**
+ * Choose the fast-tier page to be displaced from among some spaces' pages by QoS class:  from the lowest class holding more frames
+ * than its reserve, or, if every class is within its reserve, from the lowest holding any.
+ *
+ * \param  spaces_mask The spaces whose pages may be chosen, one bit each.
+ * \return the frame number of the victim, or `NO_FRAME` if those spaces hold no page that can be displaced.
+ */
+uint64_t
+ring_victim (uint32_t spaces_mask) {
+
+  for (int within_reserve = 0; within_reserve < 2; within_reserve += 1) {
+    for (int qos_class = 0; qos_class < VMSIM_QOS_CLASSES; qos_class += 1) {
+
+      if (class_frames[qos_class] == 0 || (!within_reserve && class_frames[qos_class] <= class_reserves[qos_class])) {
+        continue;
+      }
+      for (int i = 0; i < MAX_SPACES; i += 1) {
+        int space = (class_turns[qos_class] + i) % MAX_SPACES;
+        int ring  = (space * VMSIM_QOS_CLASSES) + qos_class;
+        if ((spaces_mask & (1u << space)) == 0 || ring_frames[ring] == 0) {
+          continue;
+        }
+        uint64_t victim = sweep_ring(ring);
+        if (victim == NO_FRAME) {
+          continue;
+        }
+        // The turn passes to the next space once this one has given up a lap's worth of victims.
+        if (space != class_turns[qos_class]) {
+          class_turns[qos_class]     = space;
+          class_turn_left[qos_class] = ring_frames[ring];
+        }
+        if (class_turn_left[qos_class] <= 1) {
+          class_turns[qos_class]     = (space + 1) % MAX_SPACES;
+          class_turn_left[qos_class] = 0;
+        } else {
+          class_turn_left[qos_class] -= 1;
+        }
+        qos_stats.victims[qos_class] += 1;
+        qos_stats.reserve_breaches   += within_reserve;
+        return victim;
+      }
+
+    }
+  }
+  return NO_FRAME;
+
+} // ring_victim ()
+
+
+
+/**
+ * \return the spaces, one bit each, holding more fast-tier frames than their allotments.
+ */
+uint32_t
+over_allotment () {
+
+  uint32_t spaces_mask = 0;
+  for (int i = 0; i < MAX_SPACES; i += 1) {
+    if (spaces[i].created && space_frames(i) > spaces[i].stats.allotment) {
+      spaces_mask |= (1u << i);
+    }
+  }
+  return spaces_mask;
+
+} // over_allotment ()
+
+
+
+/**
+ * Choose the page to be displaced from a node's fast-tier frames of a color, or any of its frames for `ANY_COLOR`, by CLOCK over
+ * just those frames.  None of them may be pooled.  With a single bin, the page is chosen from the rings if QoS classes or local
+ * replacement are in use, under local replacement from the spaces above their allotments if there are any.
+ *
+ * \return the frame number of the victim.
+ */
+uint64_t
+node_victim (int node, int color) {
+
+  if (bin_count == 1 && (qos_active || local_replacement)) {
+    uint64_t victim = ring_victim(local_replacement ? over_allotment() : ALL_SPACES);
+    if (victim == NO_FRAME) {
+      victim = ring_victim(ALL_SPACES);
+    }
+    assert(victim != NO_FRAME);
+    return victim;
+  }
+  if (bin_count == 1) {
+    return search_range(&cur_page_no, 0, fast_frames);
+  }
+  uint64_t first = node_first(node);
+  uint64_t end   = node_first(node + 1);
+  if (color == ANY_COLOR) {
+    return search_range(&node_hands[node], first, end - first);
+  }
+  uint64_t colored = first + ((color - color_of(first) + page_colors) % page_colors);
+  return search_stride(&bin_hands[(node * page_colors) + color], colored, bin_size((node * page_colors) + color), page_colors);
+
+} // node_victim ()
+
+
+
+/**
+ * Make room for a page of a space by displacing the page in a fast-tier frame:  demoting it if real memory is tiered, and otherwise
+ * evicting it.
+ *
+ * \param  victim The frame number.
+ * \param  space  The space for whose page the frame is wanted.
+ * \return the _real_ base address of the frame, now zero-filled.
+ */
+vmsim_addr_t
+displace_page (uint64_t victim, int space) {
+
+  if (owners[victim] == space) {
+    spaces[space].stats.self_evictions += 1;
+  } else {
+    spaces[owners[victim]].stats.frames_lost += 1;
+  }
+  if (slow_size != 0) {
+    displacing    = victim;
+    uint64_t slow = allocate_slow_page();
+    displacing    = NO_FRAME;
+    migrate_page(victim, slow);
+    tier_stats.demotions += 1;
+    pc_zero(real_base + frame_addr(victim));
+    return frame_addr(victim);
+  }
+  return move_to_bs(entries[victim]);
+
+} // displace_page ()
+
+
+
+/**
+ * Allocate a page of real memory space for backing a simulated page.  Taken from the general pool of real memory.  When the real
+ * memory is tiered, the page always comes from the fast tier, demoting the coldest fast-tier page to make room if necessary.  With
+ * NUMA nodes, the page goes on the node chosen by the placement policy, or failing that the nearest node with a free frame.  When
+ * coloring, the frame is of the color chosen for the page.  Under local replacement, a space holding its whole allotment gives up
+ * one of its own pages instead.
+ *
+ * \param  lower_pte_addr The _real_ address of the lower PTE of the page to be backed.
+ * \param  space          The space to which the page belongs.
+ * \return The _real_ base address of a page of memory.
+ */
+vmsim_addr_t
+allocate_real_page (vmsim_addr_t lower_pte_addr, int space) {
+
+  if (local_replacement && bin_count == 1 && space_frames(space) >= spaces[space].stats.allotment) {
+    uint64_t victim = ring_victim(1u << space);
+    if (victim != NO_FRAME) {
+      return displace_page(victim, space);
+    }
+  }
+
+  // Pooled frames were zeroed when their pages left.
+  int      node  = place_page();
+  int      color = choose_color(node, lower_pte_addr, space);
+  if (color != ANY_COLOR && bin_size((node * page_colors) + color) == 0) {
+    color = ANY_COLOR;
+  }
+  uint64_t frame = take_pooled_frame(node, color, numa_policy != VMSIM_NUMA_BIND);
+  if (frame == NO_FRAME && bin_count > 1 && bin_pinned(node, color)) {
+    // Copies have pinned every frame that the page could displace, so it takes a pooled frame from any bin, or else displaces a
+    // page on the first node with an unpinned frame, which there must be while no more than a quarter of the frames are pinned.
+    frame = take_pooled_frame(node, ANY_COLOR, true);
+    color = ANY_COLOR;
+    while (frame == NO_FRAME && bin_pinned(node, ANY_COLOR)) {
+      node = (node + 1) % numa_nodes;
+    }
+  }
+  if (frame != NO_FRAME) {
+    numa_stats.allocations[node_of(frame)] += 1;
+    return frame_addr(frame);
+  }
+  numa_stats.allocations[node] += 1;
+
+  if (slow_size != 0 && real_free_addr >= frame_addr(fast_frames)) {
+    return displace_page(node_victim(node, color), space);
+  }
+
+  // Once real memory is exhausted, stop advancing the free pointer (which would otherwise wrap after enough evictions).
+  //assert(real_free_addr <= real_size); //TODO: change me!
+  if (real_free_addr + PAGESIZE > real_size){    //out of space?
+    if(!overflowed){//DEBUG: tell me if we have overflowed onto BS
+      overflowed = true;
+      //show_entries();
+    }
+    uint64_t victim = node_victim(node, color);          //find an NRU page
+    return displace_page(victim, space);                 //move its contents to BS and give the newly freed page.
+  }
+
+  vmsim_addr_t new_real_addr = real_free_addr;
+  real_free_addr += PAGESIZE;
+  assert(IS_ALIGNED(new_real_addr));
+  void* new_real_ptr = (void*)(real_base + new_real_addr);
+  pc_zero(new_real_ptr);
+
+  return new_real_addr;
+  
+} // allocate_real_page ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Harvest the reference bit of the page in a frame.  A set bit is cleared and recorded in the young bit, so that CLOCK still counts
+ * the reference, and restarts the page's idle age.
+ *
+ * \param  page_no The number of a frame that holds a page.
+ * \return whether the page has been referenced since its bit was last harvested.
+ */
+bool
+harvest_frame (uint64_t page_no) {
+
+  pt_entry_t lower_pte = *entries[page_no];
+  if (!(lower_pte & PTE_REFERENCED_BIT)) {
+    return false;
+  }
+  lower_pte = (lower_pte & ~PTE_REFERENCED_BIT) | PTE_YOUNG_BIT;
+  vmsim_write_real(&lower_pte, get_real_address(entries[page_no]), sizeof(pt_entry_t));
+  idle_ages[page_no] = 0;
+  return true;
+
+} // harvest_frame ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Harvest the reference bit of a _simulated_ page for the access monitor, as `harvest_frame()` does.
+ *
+ * \param  space     The space to which the page belongs, whether or not it is current.
+ * \param  page_addr The _simulated_ base address of the page.
+ * \return whether the page has been referenced since its bit was last harvested.
+ */
+bool
+harvest_page (int space, vmsim_addr_t page_addr) {
+
+  vmsim_addr_t lower_pte_addr = space_lower_pte(space, page_addr, false);
+  if (lower_pte_addr == 0) {
+    return false;
+  }
+  pt_entry_t lower_pte;
+  vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+  return IS_RESIDENT(lower_pte) && harvest_frame(get_page_no(GET_PAGE_ADDR(lower_pte)));
+
+} // harvest_page ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Find the page table entries that a hardware walk would read to translate a _simulated_ address, for the cache model.
+ *
+ * \param  sim_addr  The _simulated_ address.
+ * \param  pte_addrs Where to store the _real_ addresses of the upper PTE and, if there is a lower page table, the lower PTE.
+ * \return the number of entries read.
+ */
+int
+walk_page (vmsim_addr_t sim_addr, vmsim_addr_t* pte_addrs) {
+
+  pte_addrs[0] = upper_pt + (GET_UPPER_INDEX(sim_addr) * sizeof(pt_entry_t));
+  pte_addrs[1] = lookup_lower_pte(sim_addr);
+  return (pte_addrs[1] == 0) ? 1 : 2;
+
+} // walk_page ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Split the fast tier into NUMA nodes, reading the nodes, their distances and the placement policy from the environment.  With more
+ * than one node, every fast-tier frame is pooled at once, so that each node's allocator can find its own frames.
+ */
+void
+numa_init () {
+
+  numa_nodes = getenv_u64("VMSIM_NUMA_NODES", numa_nodes);
+  assert(numa_nodes >= 1 && numa_nodes <= VMSIM_MAX_NODES && (uint64_t)numa_nodes <= fast_frames);
+  for (int i = 0; i < numa_nodes; i += 1) {
+    for (int j = 0; j < numa_nodes; j += 1) {
+      numa_distances[i][j] = (i == j) ? LOCAL_DISTANCE : DEFAULT_REMOTE_DISTANCE;
+    }
+  }
+  char* distances_envvar = getenv("VMSIM_NUMA_DISTANCES");
+  for (int k = 0; distances_envvar != NULL && k < numa_nodes * numa_nodes; k += 1) {
+    char* end;
+    numa_distances[k / numa_nodes][k % numa_nodes] = strtoull(distances_envvar, &end, 10);
+    assert(end != distances_envvar && (*end == ',' || *end == '\0'));
+    distances_envvar = (*end == ',') ? end + 1 : NULL;
+  }
+
+  char* policy_envvar = getenv("VMSIM_NUMA_POLICY");
+  if (policy_envvar != NULL) {
+    vmsim_numa_set_policy(strcmp(policy_envvar, "interleave") == 0 ? VMSIM_NUMA_INTERLEAVE :
+                          strcmp(policy_envvar, "bind")       == 0 ? VMSIM_NUMA_BIND       :
+                                                                     VMSIM_NUMA_FIRST_TOUCH,
+                          getenv_u64("VMSIM_NUMA_BIND_NODE", 0));
+  }
+  numa_balancing   = getenv_u64("VMSIM_NUMA_BALANCE",          0) != 0;
+  balance_interval = getenv_u64("VMSIM_NUMA_BALANCE_INTERVAL", balance_interval);
+  assert(balance_interval > 0);
+  numa_stats.nodes = numa_nodes;
+
+} // numa_init ()
+
+
+
+/**
+ * Choose the page colors, reading the coloring mode from the environment, and lay out the pool's bins.  With more than one bin,
+ * every fast-tier frame is pooled at once, so that each bin's allocator can find its own frames.
+ */
+void
+pool_init () {
+
+  // Take the number of colors from the cache model's last-level cache when there is one, as a power of two that a lower table's
+  // worth of pages covers, so that a page's virtual color is fixed by its lower index.
+  char* coloring_envvar = getenv("VMSIM_PAGE_COLORING");
+  if (coloring_envvar != NULL) {
+    coloring = (strcmp(coloring_envvar, "space")   == 0) ? COLORING_SPACE   :
+               (strcmp(coloring_envvar, "virtual") == 0) ? COLORING_VIRTUAL : COLORING_NONE;
+  }
+  if (coloring != COLORING_NONE) {
+    uint64_t colors = getenv_u64("VMSIM_PAGE_COLORS", (cm_page_colors() != 0) ? cm_page_colors() : DEFAULT_PAGE_COLORS);
+    assert(colors > 0);
+    for (page_colors = 1; (uint64_t)page_colors * 2 <= colors && (uint64_t)page_colors * 2 <= MAX_PAGE_COLORS; page_colors *= 2);
+    spaces[0].color_count = page_colors;
+  }
+
+  bin_count  = numa_nodes * page_colors;
+  bin_firsts = calloc(bin_count, sizeof(uint64_t));
+  bin_counts = calloc(bin_count, sizeof(uint64_t));
+  bin_fresh  = calloc(bin_count, sizeof(uint64_t));
+  bin_hands  = calloc(bin_count, sizeof(uint64_t));
+  bin_pins   = calloc(bin_count, sizeof(uint64_t));
+  assert(bin_firsts != NULL && bin_counts != NULL && bin_fresh != NULL && bin_hands != NULL && bin_pins != NULL);
+  if (bin_count > 1) {
+    for (uint64_t i = 0; i < fast_frames; i += 1) {
+      bin_fresh[bin_of(i)] += 1;
+    }
+    for (int bin = 1; bin < bin_count; bin += 1) {
+      bin_firsts[bin] = bin_firsts[bin - 1] + bin_fresh[bin - 1];
+    }
+    for (uint64_t i = fast_frames; i > 0; i -= 1) {
+      pool_frame(i - 1);
+    }
+    real_free_addr = frame_addr(fast_frames);
+  }
+
+} // pool_init ()
+
+
+
+void
+vmsim_init () {
+
+  // Only initialize if it hasn't already happened.
+  if (real_base == NULL) {
+
+    // Determine the real memory size, preferrably by environment variable, otherwise use the default.
+    char* real_size_envvar = getenv("VMSIM_REAL_MEM_SIZE");
+    if (real_size_envvar != NULL) {
+      errno = 0;
+      real_size = strtoul(real_size_envvar, NULL, 10);
+      assert(errno == 0);
+    }
+
+    // Map the real storage space.
+    real_base = mmap(NULL, real_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(real_base != NULL);
+    real_limit = (void*)((intptr_t)real_base + real_size);
+    upper_pt = allocate_pt();
+
+    // Initialize the simualted space allocator.  Leave page 0 unused, start at page 1.
+    sim_free_addr = PAGESIZE;
+    spaces[0].created     = true;
+    spaces[0].upper_pt    = upper_pt;
+    spaces[0].color_count = 1;
+
+    // Initialize the supporting components.
+    mmu_init(upper_pt);
+    pc_init();
+    bs_init();
+    wb_init();
+    pg_init();
+    prefetching = pf_init();
+    monitoring = mon_init(harvest_page, MAX_SPACES);
+    cache_modeling = cm_init(walk_page);
+    fault_around = getenv_u64("VMSIM_FAULT_AROUND", fault_around);
+
+    // Initialize the lpt entry array.
+    ENTRIES_LENGTH = (real_size - PT_AREA_SIZE) / PAGESIZE;
+    entries = malloc(sizeof(pt_entry_t*) * ENTRIES_LENGTH);
+    histories = calloc(ENTRIES_LENGTH, sizeof(uint8_t));
+    frame_blocks = calloc(ENTRIES_LENGTH, sizeof(unsigned int));
+    prefetched = calloc(ENTRIES_LENGTH, sizeof(bool));
+    idle_ages = calloc(ENTRIES_LENGTH, sizeof(uint16_t));
+    free_pool = calloc(ENTRIES_LENGTH, sizeof(uint64_t));
+    owners = calloc(ENTRIES_LENGTH, sizeof(uint8_t));
+    hint_nodes = calloc(ENTRIES_LENGTH, sizeof(uint8_t));
+    pins = calloc(ENTRIES_LENGTH, sizeof(uint16_t));
+    frame_classes = calloc(ENTRIES_LENGTH, sizeof(uint8_t));
+    class_next = malloc(sizeof(uint64_t) * ENTRIES_LENGTH);
+    class_prev = malloc(sizeof(uint64_t) * ENTRIES_LENGTH);
+    frame_rings = calloc(ENTRIES_LENGTH, sizeof(uint8_t));
+    assert(entries != NULL && histories != NULL && frame_blocks != NULL && prefetched != NULL);
+    assert(idle_ages != NULL && free_pool != NULL && owners != NULL && hint_nodes != NULL && pins != NULL);
+    assert(frame_classes != NULL && class_next != NULL && class_prev != NULL && frame_rings != NULL);
+    memset(hint_nodes, UINT8_MAX, sizeof(uint8_t) * ENTRIES_LENGTH);
+    memset(class_next, UINT8_MAX, sizeof(uint64_t) * ENTRIES_LENGTH);
+    reclaim_interval = getenv_u64("VMSIM_RECLAIM_INTERVAL", reclaim_interval);
+    reclaim_batch    = getenv_u64("VMSIM_RECLAIM_BATCH",    reclaim_batch);
+    reclaim_age      = getenv_u64("VMSIM_RECLAIM_AGE",      reclaim_age);
+    load_control     = getenv_u64("VMSIM_LOAD_CONTROL",     0) != 0;
+    load_window      = getenv_u64("VMSIM_LOAD_WINDOW",      load_window);
+    thrash_threshold = getenv_u64("VMSIM_THRASH_THRESHOLD", thrash_threshold);
+    resume_threshold = getenv_u64("VMSIM_RESUME_THRESHOLD", resume_threshold);
+    min_suspension   = getenv_u64("VMSIM_MIN_SUSPENSION",   min_suspension);
+    prepaging        = getenv_u64("VMSIM_PREPAGE",          1) != 0;
+    refault_activate = getenv_u64("VMSIM_REFAULT_ACTIVATE", 0) != 0;
+    compact_interval = getenv_u64("VMSIM_COMPACT_INTERVAL", compact_interval);
+    compact_pages    = getenv_u64("VMSIM_COMPACT_PAGES",    compact_pages);
+    assert(load_window > 0 && compact_pages > 0);
+
+    // Choose the replacement scope, and configure the controller of the allotments for local replacement.
+    char* replacement_envvar = getenv("VMSIM_REPLACEMENT");
+    local_replacement = (replacement_envvar != NULL && strcmp(replacement_envvar, "local") == 0);
+    assert(replacement_envvar == NULL || local_replacement || strcmp(replacement_envvar, "global") == 0);
+    pff_control = getenv_u64("VMSIM_PFF_CONTROL", 0) != 0;
+    pff_upper   = getenv_u64("VMSIM_PFF_UPPER",   pff_upper);
+    pff_lower   = getenv_u64("VMSIM_PFF_LOWER",   pff_lower);
+    pff_step    = getenv_u64("VMSIM_PFF_STEP",    pff_step);
+    pff_min     = getenv_u64("VMSIM_PFF_MIN",     pff_min);
+    assert(pff_lower <= pff_upper && pff_step > 0);
+
+    // Split the frames into a fast and a slow tier, the slow tier being the top of real memory.
+    slow_size    = getenv_u64("VMSIM_SLOW_MEM_SIZE",    slow_size);
+    fast_latency = getenv_u64("VMSIM_FAST_MEM_LATENCY", fast_latency);
+    slow_latency = getenv_u64("VMSIM_SLOW_MEM_LATENCY", slow_latency);
+    uint64_t slow_frames = slow_size / PAGESIZE;
+    assert(slow_frames == 0 || slow_frames < ENTRIES_LENGTH);
+    fast_frames    = ENTRIES_LENGTH - slow_frames;
+    slow_free_addr = frame_addr(fast_frames);
+    max_pinned     = (fast_frames / 4 > 2) ? fast_frames / 4 : 2;
+    spaces[0].stats.allotment = fast_frames;
+    numa_init();
+    pool_init();
+    
+  }
+  
+} // vmsim_init ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Map a _simulated_ address to a _real_ one, ensuring first that the page table and real spaces are initialized.
+ *
+ * \param  sim_addr        The _simulated_ address to translate.
+ * \param  write_operation Whether the memory access is to _read_ (`false`) or to _write_ (`true`).
+ * \return the translated _real_ address.
+ */ 
+vmsim_addr_t
+vmsim_map (vmsim_addr_t sim_addr, bool write_operation) {
+
+  vmsim_init();
+
+  assert(real_base != NULL);
+  vmsim_addr_t real_addr = mmu_translate(sim_addr, write_operation);
+  return real_addr;
+  
+} // vmsim_map ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Find the lower PTE for a _simulated_ address, without creating any page table.
+ *
+ * \param  sim_addr The _simulated_ address to look up.
+ * \return the _real_ address of the lower PTE, or 0 if the address has no lower page table.
+ */
+vmsim_addr_t
+lookup_lower_pte (vmsim_addr_t sim_addr) {
+
+  pt_entry_t upper_pte;
+  vmsim_read_real(&upper_pte, upper_pt + (GET_UPPER_INDEX(sim_addr) * sizeof(pt_entry_t)), sizeof(upper_pte));
+  if (upper_pte == 0) {
+    return 0;
+  }
+  return GET_PAGE_ADDR(upper_pte) + (GET_LOWER_INDEX(sim_addr) * sizeof(pt_entry_t));
+
+} // lookup_lower_pte ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Feed a fault to the prefetcher, and swap in those predicted pages that are mapped but not resident.
+ *
+ * \param sim_addr The _simulated_ address that faulted.
+ * \param swap_in  Whether the fault swapped its page in.
+ */
+void
+prefetch_after_fault (vmsim_addr_t sim_addr, bool swap_in) {
+
+  // Never prefetch so much that the pages just brought in could push each other out.
+  vmsim_addr_t predictions[MAX_PREFETCH];
+  int          max   = (ENTRIES_LENGTH / 4 < MAX_PREFETCH) ? ENTRIES_LENGTH / 4 : MAX_PREFETCH;
+  int          count = pf_fault(GET_PAGE_ADDR(sim_addr), swap_in, predictions, max);
+
+  for (int i = 0; i < count; i += 1) {
+    vmsim_addr_t lower_pte_addr = lookup_lower_pte(predictions[i]);
+    if (lower_pte_addr == 0) {
+      continue;
+    }
+    pt_entry_t lower_pte;
+    vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    if (lower_pte == 0 || IS_RESIDENT(lower_pte)) {
+      continue;
+    }
+    vmsim_addr_t real_addr = allocate_real_page(lower_pte_addr, current_space);
+    move_to_mm(lower_pte_addr, real_addr);
+    prefetched[get_page_no(real_addr)] = true;
+    pf_issued();
+  }
+
+} // prefetch_after_fault ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Back an unmapped _simulated_ page with a given zero-filled real page.
+ *
+ * \param  lower_pte_addr The _real_ address of the page's lower PTE, which must be 0.
+ * \param  real_addr      The _real_ base address of a free frame.
+ * \param  space          The space to which the page belongs.
+ * \return the new lower PTE.
+ */
+pt_entry_t
+map_frame (vmsim_addr_t lower_pte_addr, vmsim_addr_t real_addr, int space) {
+
+  pt_entry_t   lower_pte = real_addr;
+  SET_RESIDENT(lower_pte);
+  vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(pt_entry_t));
+
+  //record pointer to lower pte in entries
+  entries[get_page_no(real_addr)] = (pt_entry_t*)(lower_pte_addr + real_base);
+  histories[get_page_no(real_addr)] = 0;
+  frame_blocks[get_page_no(real_addr)] = 0;
+  prefetched[get_page_no(real_addr)] = false;
+  idle_ages[get_page_no(real_addr)] = 0;
+  owners[get_page_no(real_addr)] = space;
+  hint_nodes[get_page_no(real_addr)] = UINT8_MAX;
+  frame_classes[get_page_no(real_addr)] = page_class(space, pte_page_addr(lower_pte_addr));
+  class_link(get_page_no(real_addr));
+  spaces[space].stats.resident += 1;
+  return lower_pte;
+
+} // map_frame ()
+
+
+
+/**
+ * Queue a newly mapped page to be filled by its pager, if one covers it.
+ *
+ * \param lower_pte_addr The _real_ address of the page's lower PTE.
+ * \param real_addr      The _real_ base address of the page's frame.
+ * \param space          The space to which the page belongs.
+ */
+void
+fill_from_pager (vmsim_addr_t lower_pte_addr, vmsim_addr_t real_addr, int space) {
+
+  vmsim_addr_t page  = pte_page_addr(lower_pte_addr);
+  int          pager = pg_find(space, page);
+  if (pager != -1) {
+    pg_fill(pager, page, real_base + real_addr);
+  }
+
+} // fill_from_pager ()
+
+
+
+/**
+ * Back an unmapped _simulated_ page with a new real page:  zero-filled, or, if a pager covers the page, queued to be filled by it.
+ *
+ * \param  lower_pte_addr The _real_ address of the page's lower PTE, which must be 0.
+ * \return the new lower PTE.
+ */
+pt_entry_t
+map_new_page (vmsim_addr_t lower_pte_addr) {
+
+  vmsim_addr_t real_addr = allocate_real_page(lower_pte_addr, current_space);
+  pt_entry_t   lower_pte = map_frame(lower_pte_addr, real_addr, current_space);
+  fill_from_pager(lower_pte_addr, real_addr, current_space);
+  return lower_pte;
+
+} // map_new_page ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Map the unmapped pages in the aligned window of `fault_around` pages around a first-touch fault.  The window is clipped to the
+ * lower table that covers the fault and to the allocated part of the simulated space.
+ *
+ * \param sim_addr The _simulated_ address that faulted.
+ * \param lower_pt The _real_ base address of the lower table covering it.
+ */
+void
+map_around (vmsim_addr_t sim_addr, vmsim_addr_t lower_pt) {
+
+  // Never map so many pages at once that they could push each other out.
+  uint64_t window = (fault_around < ENTRIES_LENGTH / 4) ? fault_around : ENTRIES_LENGTH / 4;
+  if (window <= 1) {
+    return;
+  }
+  vmsim_addr_t first_index = GET_LOWER_INDEX(sim_addr) - (GET_LOWER_INDEX(sim_addr) % window);
+  vmsim_addr_t table_base  = sim_addr & ~((vmsim_addr_t)(PT_ENTRIES * PAGESIZE) - 1);
+
+  for (vmsim_addr_t index = first_index; index < first_index + window && index < PT_ENTRIES; index += 1) {
+    vmsim_addr_t page_addr = table_base + (index * PAGESIZE);
+    if (page_addr < PAGESIZE || page_addr >= sim_free_addr || index == GET_LOWER_INDEX(sim_addr)) {
+      continue;
+    }
+    vmsim_addr_t lower_pte_addr = lower_pt + (index * sizeof(pt_entry_t));
+    pt_entry_t   lower_pte;
+    vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    if (lower_pte == 0) {
+      map_new_page(lower_pte_addr);
+      fault_stats.fault_around += 1;
+    }
+  }
+
+} // map_around ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Called when the translation of a _simulated_ address fails.  When this function is done, a _real_ page will back the _simulated_
+ * one that contains the given address, with the page tables appropriately updated.
+ *
+ * \param sim_addr The _simulated_ address for which address translation failed.
+ */
+void
+vmsim_map_fault (vmsim_addr_t sim_addr) {
+
+  assert(upper_pt != 0);
+
+  // Grab the upper table's entry.
+  vmsim_addr_t upper_index    = GET_UPPER_INDEX(sim_addr);
+  vmsim_addr_t upper_pte_addr = upper_pt + (upper_index * sizeof(pt_entry_t));
+  pt_entry_t   upper_pte;
+  vmsim_read_real(&upper_pte, upper_pte_addr, sizeof(upper_pte));
+
+  // If the lower table doesn't exist, create it and update the upper table.
+  if (upper_pte == 0) {
+
+    upper_pte = allocate_lower_pt(sim_addr);
+    assert(upper_pte != 0);
+    vmsim_write_real(&upper_pte, upper_pte_addr, sizeof(upper_pte));
+    
+  }
+
+  // Grab the lower table's entry.
+  vmsim_addr_t lower_pt       = GET_PAGE_ADDR(upper_pte);
+  vmsim_addr_t lower_index    = GET_LOWER_INDEX(sim_addr);
+  vmsim_addr_t lower_pte_addr = lower_pt + (lower_index * sizeof(pt_entry_t));
+  pt_entry_t   lower_pte;
+  vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+
+  // If there is no mapped page, create it and update the lower table.
+  bool first_touch = (lower_pte == 0);
+  if (first_touch) {
+
+    lower_pte = map_new_page(lower_pte_addr);
+    fault_stats.first_touch += 1;
+
+    //DEBUG: update last pte
+    last_pte = &lower_pte;
+
+
+  }  
+  //unsigned int test = IS_RESIDENT(lower_pte);
+  //printf("%u", test);
+  //printf("%u", ~IS_RESIDENT(lower_pte));
+  //fflush(stdout);
+  bool swapped_in = false;
+  if (IS_RESIDENT(lower_pte)==0){//if it is not resident, we need to swap it in
+    vmsim_addr_t real_addr = allocate_real_page(lower_pte_addr, current_space);
+    move_to_mm(lower_pte_addr, real_addr);
+    swapped_in = true;
+    fault_stats.swap_ins += 1;
+    account_refault(lower_pte_addr);
+  }
+  fault_stats.faults += 1;
+  spaces[current_space].stats.faults += 1;
+  spaces[current_space].window_faults += 1;
+
+  // The faulting page is about to be referenced; mark it so now, so that making room for neighbouring or predicted pages cannot
+  // evict it.
+  if (prefetching || (first_touch && fault_around > 1)) {
+    vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    SET_REFERENCED(lower_pte);
+    vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+  }
+
+  // Map the untouched neighbours of a first-touch page while their lower table is at hand.
+  if (first_touch && fault_around > 1) {
+    map_around(sim_addr, lower_pt);
+  }
+
+  // Bring in the pages expected to fault next.
+  if (prefetching) {
+    prefetch_after_fault(sim_addr, swapped_in);
+  }
+
+  // Let the tiers rebalance a little on every fault.
+  if (slow_size != 0) {
+    scan_slow_tier();
+  }
+
+  // Deliver the fault's pager traffic before the faulting access reads the page.
+  pg_flush();
+  
+} // vmsim_map_fault ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_read_real (void* buffer, vmsim_addr_t real_addr, size_t size) {
+
+  // Get a pointer into the real space and check the bounds.
+  void* ptr = real_base + real_addr;
+  void* end = (void*)((intptr_t)ptr + size);
+  assert(end <= real_limit);
+
+  // Copy the requested bytes from the real space, using the page kernel for whole pages.
+  if (size == PAGESIZE) {
+    pc_copy(buffer, ptr);
+  } else {
+    memcpy(buffer, ptr, size);
+  }
+  
+} // vmsim_read_real ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_write_real (void* buffer, vmsim_addr_t real_addr, size_t size) {
+
+  // Get a pointer into the real space and check the bounds.
+  void* ptr = real_base + real_addr;
+  void* end = (void*)((intptr_t)ptr + size);
+  assert(end <= real_limit);
+
+  // Copy the requested bytes into the real space, using the page kernel for whole pages.
+  if (size == PAGESIZE) {
+    pc_copy(ptr, buffer);
+  } else {
+    memcpy(ptr, buffer, size);
+  }
+  
+} // vmsim_write_real ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_stream_real (void* buffer, vmsim_addr_t real_addr) {
+
+  // Get a pointer into the real space and check the bounds.
+  void* ptr = real_base + real_addr;
+  void* end = (void*)((intptr_t)ptr + PAGESIZE);
+  assert(end <= real_limit);
+
+  // Copy the page out of the real space without pulling the destination into the cache.
+  pc_stream(buffer, ptr);
+  
+} // vmsim_stream_real ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Charge the simulated cost of one access to the tier holding the given real address, and within the fast tier, to the NUMA node.
+ *
+ * \param real_addr The translated _real_ address being accessed.
+ */
+static inline void
+charge_access (vmsim_addr_t real_addr) {
+
+  uint64_t page_no = get_page_no(real_addr);
+  if (page_no < fast_frames) {
+    int      node = node_of(page_no);
+    uint64_t cost = (fast_latency * numa_distances[home_node][node]) / LOCAL_DISTANCE;
+    tier_stats.fast_accesses += 1;
+    tier_stats.access_cost   += cost;
+    numa_stats.accesses[home_node][node] += 1;
+    numa_stats.access_cost[home_node]    += cost;
+    if (node == home_node) {
+      numa_stats.local_accesses  += 1;
+    } else {
+      numa_stats.remote_accesses += 1;
+    }
+  } else {
+    tier_stats.slow_accesses += 1;
+    tier_stats.access_cost   += slow_latency;
+  }
+
+} // charge_access ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Count one access for automatic NUMA balancing, and once the interval has elapsed, sample it as a hinting fault.  A page sampled
+ * from the same remote node as on its previous sample is moved into a pooled frame on that node, if it has one.  The page's
+ * accesses must be complete, since it may move.
+ *
+ * \param real_addr The translated _real_ address just accessed.
+ */
+void
+balance_tick (vmsim_addr_t real_addr) {
+
+  balance_ticks += 1;
+  if (balance_ticks < balance_interval) {
+    return;
+  }
+  balance_ticks = 0;
+
+  // Slow-tier pages are left to the promotion scanner, and pinned pages stay where they are.
+  uint64_t page_no = get_page_no(real_addr);
+  if (page_no >= fast_frames || pins[page_no] > 0) {
+    return;
+  }
+  numa_stats.hint_faults += 1;
+  int previous = hint_nodes[page_no];
+  hint_nodes[page_no] = home_node;
+  if (node_of(page_no) == home_node || previous != home_node) {
+    return;
+  }
+
+  // Displacing a page from a full node would only start it moving back, so the move waits for a free frame there.
+  uint64_t to = take_pooled_frame(home_node, (coloring == COLORING_NONE) ? ANY_COLOR : color_of(page_no), false);
+  if (to == NO_FRAME) {
+    numa_stats.failed_migrations += 1;
+    return;
+  }
+  migrate_page(page_no, to);
+  pc_zero_stream(real_base + frame_addr(page_no));
+  pool_frame(page_no);
+  numa_stats.migrations += 1;
+
+} // balance_tick ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Find the first run of free frames of a given length among the frames [first, end).
+ *
+ * \param  first   The number of the first frame to consider.
+ * \param  end     The number just past the last frame to consider.
+ * \param  count   The length of the run.
+ * \param  longest Where to store the length of the longest free run seen before the search stopped.
+ * \return the number of the first frame of the run, or `NO_FRAME` if there is none.
+ */
+uint64_t
+find_free_run (uint64_t first, uint64_t end, uint64_t count, uint64_t* longest) {
+
+  uint64_t run = 0;
+  *longest = 0;
+  for (uint64_t i = first; i < end; i += 1) {
+    run = (entries[i] == NULL) ? run + 1 : 0;
+    if (run > *longest) {
+      *longest = run;
+    }
+    if (run == count) {
+      return i + 1 - count;
+    }
+  }
+  return NO_FRAME;
+
+} // find_free_run ()
+
+
+
+/**
+ * Take a particular free fast-tier frame for use:  out of its bin of the pool, or from above the bump pointer, in which case the
+ * frames skipped over are pooled.
+ *
+ * \param page_no The number of the frame.
+ */
+void
+claim_frame (uint64_t page_no) {
+
+  assert(page_no < fast_frames && entries[page_no] == NULL);
+  if (frame_addr(page_no) >= real_free_addr) {
+    for (uint64_t i = get_page_no(real_free_addr); i < page_no; i += 1) {
+      pc_zero(real_base + frame_addr(i));
+      pool_frame(i);
+    }
+    real_free_addr = frame_addr(page_no + 1);
+    pc_zero(real_base + frame_addr(page_no));
+    return;
+  }
+
+  // Never-used frames stay at the bottom of the bin, so a claimed one is replaced by the last of them, and that by the top frame.
+  int       bin  = bin_of(page_no);
+  uint64_t* pool = &free_pool[bin_firsts[bin]];
+  uint64_t  slot = 0;
+  while (pool[slot] != page_no) {
+    slot += 1;
+    assert(slot < bin_counts[bin]);
+  }
+  if (slot < bin_fresh[bin]) {
+    bin_fresh[bin] -= 1;
+    pool[slot]      = pool[bin_fresh[bin]];
+    slot            = bin_fresh[bin];
+  }
+  bin_counts[bin] -= 1;
+  pool[slot]       = pool[bin_counts[bin]];
+
+} // claim_frame ()
+
+
+
+/**
+ * Compact a node's fast-tier frames until they hold a free run of a given length.  The run is placed where the fewest pages are in
+ * the way, and each of those is moved into the highest free frame outside it, as a free scanner working down from the top of the
+ * node would find them.  The frames of the run are left pooled.
+ *
+ * \param  node  The node.
+ * \param  count The length of the run.
+ * \param  evict Whether, for lack of free frames to move them to, pages may be demoted to the slow tier or evicted.
+ * \return the number of the first frame of the run, or `NO_FRAME` if it could not be built.
+ */
+uint64_t
+compact_frames (int node, uint64_t count, bool evict) {
+
+  uint64_t first = node_first(node);
+  uint64_t end   = node_first(node + 1);
+  uint64_t longest;
+  if (count == 0 || count > end - first) {
+    compaction_stats.failures += 1;
+    return NO_FRAME;
+  }
+  uint64_t run = find_free_run(first, end, count, &longest);
+  if (run != NO_FRAME) {
+    compaction_stats.runs += 1;
+    return run;
+  }
+
+  // Slide a window of the run's length over the node, counting the pages in it.  Pinned pages cannot move, so no window may hold
+  // one.
+  uint64_t used        = 0;
+  uint64_t pinned      = 0;
+  uint64_t fewest      = UINT64_MAX;
+  uint64_t free_frames = 0;
+  for (uint64_t i = first; i < end; i += 1) {
+    used        += (entries[i] != NULL);
+    pinned      += (pins[i] > 0);
+    free_frames += (entries[i] == NULL);
+    if (i >= first + count) {
+      used   -= (entries[i - count] != NULL);
+      pinned -= (pins[i - count] > 0);
+    }
+    if (i + 1 >= first + count && pinned == 0 && used < fewest) {
+      fewest = used;
+      run    = i + 1 - count;
+    }
+  }
+  if (fewest == UINT64_MAX || (free_frames < count && !evict)) {
+    compaction_stats.failures += 1;
+    return NO_FRAME;
+  }
+
+  compacting = true;
+  uint64_t target = end;
+  for (uint64_t i = run; i < run + count; i += 1) {
+    if (entries[i] == NULL) {
+      continue;
+    }
+    while (target > first && (entries[target - 1] != NULL || (target - 1 >= run && target - 1 < run + count))) {
+      target -= 1;
+    }
+    if (target > first) {
+      target -= 1;
+      claim_frame(target);
+      migrate_page(i, target);
+      pc_zero_stream(real_base + frame_addr(i));
+      compaction_stats.migrations += 1;
+    } else if (slow_size != 0) {
+      migrate_page(i, allocate_slow_page());
+      pc_zero_stream(real_base + frame_addr(i));
+      tier_stats.demotions        += 1;
+      compaction_stats.evictions += 1;
+    } else {
+      evict_frame(i);
+      compaction_stats.evictions += 1;
+    }
+    pool_frame(i);
+  }
+  compacting = false;
+  pg_flush();
+  compaction_stats.runs += 1;
+  return run;
+
+} // compact_frames ()
+
+
+
+/**
+ * Count one access, and once the compaction interval has elapsed, visit the next node, compacting it if it has enough free frames
+ * for a run of `compact_pages` but no such run.
+ */
+void
+compact_tick () {
+
+  compact_ticks += 1;
+  if (compact_ticks < compact_interval) {
+    return;
+  }
+  compact_ticks = 0;
+
+  int      node  = compact_next;
+  uint64_t first = node_first(node);
+  uint64_t end   = node_first(node + 1);
+  uint64_t longest;
+  compact_next = (compact_next + 1) % numa_nodes;
+  if (compact_pages > end - first || find_free_run(first, end, compact_pages, &longest) != NO_FRAME) {
+    return;
+  }
+  uint64_t free_frames = 0;
+  for (uint64_t i = first; i < end; i += 1) {
+    free_frames += (entries[i] == NULL);
+  }
+  if (free_frames >= compact_pages) {
+    compaction_stats.background += 1;
+    compact_frames(node, compact_pages, false);
+  }
+
+} // compact_tick ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_get_tier_stats (vmsim_tier_stats_t* stats) {
+
+  *stats = tier_stats;
+
+} // vmsim_get_tier_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_get_fault_stats (vmsim_fault_stats_t* stats) {
+
+  *stats = fault_stats;
+
+} // vmsim_get_fault_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Find the frames whose pages are evicted to the backing store:  the used part of the slow tier when real memory is tiered, and
+ * otherwise every used frame.
+ *
+ * \param first Where to store the number of the first such frame.
+ * \param end   Where to store the number just past the last such frame.
+ */
+void
+evictable_frames (uint64_t* first, uint64_t* end) {
+
+  if (slow_size != 0) {
+    *first = fast_frames;
+    *end   = get_page_no(slow_free_addr);
+  } else {
+    *first = 0;
+    *end   = (real_free_addr < frame_addr(fast_frames)) ? get_page_no(real_free_addr) : fast_frames;
+  }
+
+} // evictable_frames ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Count one access, and once the reclaim interval has elapsed, advance the reclaimer over its next batch of evictable frames.  Each
+ * page not referenced since the last pass ages by one; a page that reaches the idle threshold is written back if needed, evicted,
+ * and its frame pooled for a later fault.
+ */
+void
+reclaim_tick () {
+
+  reclaim_ticks += 1;
+  if (reclaim_ticks < reclaim_interval) {
+    return;
+  }
+  reclaim_ticks = 0;
+
+  uint64_t first, end;
+  evictable_frames(&first, &end);
+  if (end <= first) {
+    return;
+  }
+  uint64_t count = end - first;
+  reclaim_stats.passes += 1;
+  for (uint64_t i = 0; i < reclaim_batch && i < count; i += 1) {
+
+    uint64_t page_no = first + (reclaim_hand % count);
+    reclaim_hand     = (reclaim_hand + 1) % count;
+    if (entries[page_no] == NULL || pins[page_no] > 0) {
+      continue;
+    }
+    reclaim_stats.scanned += 1;
+    if (harvest_frame(page_no)) {
+      continue;
+    }
+    if (idle_ages[page_no] < UINT16_MAX) {
+      idle_ages[page_no] += 1;
+    }
+    if (idle_ages[page_no] >= reclaim_age) {
+      evict_frame(page_no);
+      pool_frame(page_no);
+      reclaim_stats.reclaimed += 1;
+    }
+
+  }
+  pg_flush();
+
+} // reclaim_tick ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_get_reclaim_stats (vmsim_reclaim_stats_t* stats) {
+
+  *stats = reclaim_stats;
+
+} // vmsim_get_reclaim_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_get_refault_stats (vmsim_refault_stats_t* stats) {
+
+  *stats = refault_stats;
+
+} // vmsim_get_refault_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Suspend an address space, evicting all of its pages so that their frames go to the others.  Its pages leave no shadow entries,
+ * since they were not evicted for lack of room.  The pages referenced since CLOCK last sampled them, or on its last sample, are
+ * recorded as the space's working set.
+ *
+ * \param space The space to suspend, which must not be the current one.
+ */
+void
+suspend_space (int space) {
+
+  assert(space != current_space && !spaces[space].stats.suspended && spaces[space].copies == 0);
+  space_t* suspended = &spaces[space];
+  free(suspended->working_set);
+  suspended->working_set      = malloc(sizeof(vmsim_addr_t) * (suspended->stats.resident + 1));
+  suspended->working_set_size = 0;
+  assert(suspended->working_set != NULL);
+  for (uint64_t i = 0; i < ENTRIES_LENGTH; i += 1) {
+    if (entries[i] != NULL && owners[i] == space) {
+      uint64_t     distance;
+      vmsim_addr_t lower_pte_addr = get_real_address(entries[i]);
+      if (IS_REFERENCED(*entries[i]) || (histories[i] & 0x80)) {
+        suspended->working_set[suspended->working_set_size++] = lower_pte_addr;
+      }
+      evict_frame(i);
+      recall_eviction(lower_pte_addr, &distance);
+      pool_frame(i);
+    }
+  }
+  pg_flush();
+  spaces[space].stats.suspended    = true;
+  spaces[space].stats.suspensions += 1;
+  spaces[space].suspended_windows  = 0;
+
+} // suspend_space ()
+
+
+
+/** A page to prepage:  its block and the _real_ address of its lower PTE. */
+typedef struct {
+  unsigned int block_number;
+  vmsim_addr_t lower_pte_addr;
+} prepage_t;
+
+
+
+int
+compare_prepages (const void* a, const void* b) {
+
+  unsigned int block_a = ((const prepage_t*)a)->block_number;
+  unsigned int block_b = ((const prepage_t*)b)->block_number;
+  return (block_a > block_b) - (block_a < block_b);
+
+}
+
+
+
+/**
+ * Swap a resumed space's recorded working set back in, in backing-store order and in vectored batches, rather than leaving each
+ * page to fault.  At most half of real memory is filled this way.  Each batch is read into host memory before its frames are
+ * allocated, so that making room for one page can never evict another whose data has yet to arrive.
+ *
+ * \param space The space being resumed.
+ */
+void
+prepage_space (int space) {
+
+  // Gather the recorded pages that are still out, and put them in block order.
+  space_t*   resumed = &spaces[space];
+  prepage_t* pages   = malloc(sizeof(prepage_t) * (resumed->working_set_size + 1));
+  uint64_t   count   = 0;
+  assert(pages != NULL);
+  for (uint64_t i = 0; i < resumed->working_set_size && count < ENTRIES_LENGTH / 2; i += 1) {
+    pt_entry_t lower_pte;
+    vmsim_read_real(&lower_pte, resumed->working_set[i], sizeof(lower_pte));
+    if (lower_pte != 0 && !IS_RESIDENT(lower_pte)) {
+      pages[count].block_number   = (lower_pte & 0xfffffc00) >> 10;
+      pages[count].lower_pte_addr = resumed->working_set[i];
+      count                      += 1;
+    }
+  }
+  qsort(pages, count, sizeof(prepage_t), compare_prepages);
+
+  static uint8_t buffers[PREPAGE_BATCH][PAGESIZE];
+  void*          batch_pages[PREPAGE_BATCH];
+  unsigned int   batch_blocks[PREPAGE_BATCH];
+  for (uint64_t first = 0; first < count; first += PREPAGE_BATCH) {
+
+    uint64_t batch = (count - first < PREPAGE_BATCH) ? count - first : PREPAGE_BATCH;
+    for (uint64_t i = 0; i < batch; i += 1) {
+      batch_pages[i]  = buffers[i];
+      batch_blocks[i] = pages[first + i].block_number;
+    }
+    bool success = wb_read_batch(batch_pages, batch_blocks, batch);
+    assert(success);
+
+    // Install each page as referenced, so that CLOCK gives it a pass before it can be chosen.
+    for (uint64_t i = 0; i < batch; i += 1) {
+      vmsim_addr_t real_addr = allocate_real_page(pages[first + i].lower_pte_addr, space);
+      vmsim_write_real(buffers[i], real_addr, PAGESIZE);
+      install_page(pages[first + i].lower_pte_addr, real_addr, space);
+      pt_entry_t lower_pte;
+      vmsim_read_real(&lower_pte, pages[first + i].lower_pte_addr, sizeof(lower_pte));
+      SET_REFERENCED(lower_pte);
+      vmsim_write_real(&lower_pte, pages[first + i].lower_pte_addr, sizeof(lower_pte));
+    }
+
+  }
+  pg_flush();
+  resumed->stats.prepaged += count;
+  free(pages);
+
+} // prepage_space ()
+
+
+
+/**
+ * Let a suspended address space run again, prepaging its working set if enabled.  Other pages return as it faults on them.
+ *
+ * \param space The space to resume.
+ */
+void
+resume_space (int space) {
+
+  assert(spaces[space].stats.suspended);
+  spaces[space].stats.suspended  = false;
+  spaces[space].stats.resumes   += 1;
+  if (prepaging) {
+    prepage_space(space);
+  }
+  free(spaces[space].working_set);
+  spaces[space].working_set      = NULL;
+  spaces[space].working_set_size = 0;
+
+} // resume_space ()
+
+
+
+/**
+ * \return the frames that one space may give up to another faulting often:  those beyond its working set if it is not faulting
+ *         often itself, and those beyond an equal share of the fast tier if the other is allotted less than one.
+ *
+ * \param taker The space faulting often.
+ * \param donor The space that would give up frames.
+ * \param floor The donor's working set, and no less than `pff_min`.
+ * \param share An equal share of the fast tier among the running spaces.
+ */
+uint64_t
+spare_frames (int taker, int donor, uint64_t floor, uint64_t share) {
+
+  vmsim_space_stats_t* to    = &spaces[taker].stats;
+  vmsim_space_stats_t* from  = &spaces[donor].stats;
+  uint64_t             spare = 0;
+  if (from->pff <= pff_upper && from->allotment > floor) {
+    spare = from->allotment - floor;
+  }
+  if (to->allotment < share && from->allotment > share && from->allotment - share > spare) {
+    spare = from->allotment - share;
+  }
+  return spare;
+
+} // spare_frames ()
+
+
+
+/**
+ * Adjust the allotments of the running spaces that made accesses over the last window by their page-fault frequencies.  A space
+ * faulting rarely gives up frames, but none of those holding its working set:  the pages it referenced over the window.  A space
+ * faulting often takes frames that no space is allotted, and then frames that other spaces can spare, from the one faulting least.
+ * A space idle over the window neither gives nor takes.
+ */
+void
+adjust_allotments () {
+
+  // Harvest the fast tier's reference bits, counting the pages of each space referenced since the last window.
+  uint64_t floors[MAX_SPACES] = { 0 };
+  for (uint64_t i = 0; i < fast_frames; i += 1) {
+    if (entries[i] != NULL && harvest_frame(i)) {
+      floors[owners[i]] += 1;
+    }
+  }
+
+  uint64_t allotted = 0;
+  uint64_t running  = 0;
+  for (int i = 0; i < MAX_SPACES; i += 1) {
+    vmsim_space_stats_t* stats = &spaces[i].stats;
+    if (!spaces[i].created || stats->suspended) {
+      continue;
+    }
+    floors[i] = (floors[i] > pff_min) ? floors[i] : pff_min;
+    if (spaces[i].window_accesses > 0 && stats->pff < pff_lower && stats->allotment > floors[i]) {
+      uint64_t step     = (stats->allotment - floors[i] < pff_step) ? stats->allotment - floors[i] : pff_step;
+      stats->allotment -= step;
+    }
+    allotted += stats->allotment;
+    running  += 1;
+  }
+
+  uint64_t share = (running > 0) ? fast_frames / running : fast_frames;
+  for (int i = 0; i < MAX_SPACES; i += 1) {
+    vmsim_space_stats_t* stats = &spaces[i].stats;
+    if (!spaces[i].created || stats->suspended || spaces[i].window_accesses == 0 || stats->pff <= pff_upper) {
+      continue;
+    }
+    uint64_t unallotted = (allotted < fast_frames) ? fast_frames - allotted : 0;
+    uint64_t wanted     = pff_step;
+    uint64_t grant      = (unallotted < wanted) ? unallotted : wanted;
+    stats->allotment += grant;
+    allotted         += grant;
+    wanted           -= grant;
+    while (wanted > 0) {
+      int      donor = -1;
+      uint64_t spare = 0;
+      for (int j = 0; j < MAX_SPACES; j += 1) {
+        if (j == i || !spaces[j].created || spaces[j].stats.suspended || spaces[j].window_accesses == 0) {
+          continue;
+        }
+        uint64_t frames = spare_frames(i, j, floors[j], share);
+        if (frames > 0 && (donor < 0 || spaces[j].stats.pff < spaces[donor].stats.pff)) {
+          donor = j;
+          spare = frames;
+        }
+      }
+      if (donor < 0) {
+        break;
+      }
+      uint64_t step                  = (spare < wanted) ? spare : wanted;
+      spaces[donor].stats.allotment -= step;
+      stats->allotment              += step;
+      wanted                        -= step;
+    }
+  }
+
+} // adjust_allotments ()
+
+
+
+/**
+ * Close a load-control window:  compute each space's page-fault frequency, and suspend or resume a space if the total refault rate
+ * calls for it.  The current space is never suspended, nor is the last running one.
+ */
+void
+control_load () {
+
+  uint64_t refaults = 0;
+  int      running  = 0;
+  int      victim   = -1;
+  int      wakee    = -1;
+  for (int i = 0; i < MAX_SPACES; i += 1) {
+
+    space_t* space = &spaces[i];
+    if (!space->created) {
+      continue;
+    }
+    refaults         += space->window_refaults;
+    space->stats.pff  = (space->window_accesses == 0) ? 0 : (space->window_faults * 1000) / space->window_accesses;
+
+    if (space->stats.suspended) {
+      space->suspended_windows += 1;
+      if (space->suspended_windows >= min_suspension &&
+          (wakee < 0 || space->stats.priority > spaces[wakee].stats.priority)) {
+        wakee = i;
+      }
+    } else {
+      running += 1;
+      if (i != current_space && space->stats.resident > 0 && space->copies == 0 &&
+          (victim < 0 || space->stats.priority < spaces[victim].stats.priority)) {
+        victim = i;
+      }
+    }
+
+  }
+
+  if (local_replacement && pff_control) {
+    adjust_allotments();
+  }
+  for (int i = 0; i < MAX_SPACES; i += 1) {
+    spaces[i].window_accesses = 0;
+    spaces[i].window_faults   = 0;
+    spaces[i].window_refaults = 0;
+  }
+  if (!load_control) {
+    return;
+  }
+  uint64_t rate = (refaults * 1000) / load_window;
+  if (rate >= thrash_threshold && victim >= 0 && running > 1) {
+    suspend_space(victim);
+  } else if (rate <= resume_threshold && wakee >= 0) {
+    resume_space(wakee);
+  }
+
+} // control_load ()
+
+
+
+/**
+ * Count one access by the current space, closing the load-control window when it is full.
+ */
+static inline void
+load_tick () {
+
+  spaces[current_space].stats.accesses += 1;
+  spaces[current_space].window_accesses += 1;
+  load_ticks += 1;
+  if (load_ticks == load_window) {
+    load_ticks = 0;
+    control_load();
+  }
+
+} // load_tick ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+int
+vmsim_space_create (int priority) {
+
+  vmsim_init();
+  int space = 0;
+  while (space < MAX_SPACES && spaces[space].created) {
+    space += 1;
+  }
+  assert(space < MAX_SPACES);
+
+  spaces[space].created        = true;
+  spaces[space].upper_pt       = allocate_pt();
+  spaces[space].sim_free_addr  = PAGESIZE;
+  spaces[space].color_count    = page_colors;
+  spaces[space].stats.priority = priority;
+
+  // The new space is allotted an equal share of the fast tier:  frames that no space is allotted, and then frames taken from those
+  // spaces allotted more than an equal share, down to one.  Other allotments, set or adjusted since, are left alone.
+  uint64_t created  = 0;
+  uint64_t allotted = 0;
+  for (int i = 0; i < MAX_SPACES; i += 1) {
+    created  += spaces[i].created;
+    allotted += (i != space && spaces[i].created) ? spaces[i].stats.allotment : 0;
+  }
+  uint64_t share  = fast_frames / created;
+  uint64_t wanted = (allotted + share > fast_frames) ? allotted + share - fast_frames : 0;
+  for (int i = 0; i < MAX_SPACES && wanted > 0; i += 1) {
+    vmsim_space_stats_t* stats = &spaces[i].stats;
+    if (i != space && spaces[i].created && stats->allotment > share) {
+      uint64_t step     = (stats->allotment - share < wanted) ? stats->allotment - share : wanted;
+      stats->allotment -= step;
+      wanted           -= step;
+    }
+  }
+  spaces[space].stats.allotment = share - wanted;
+  return space;
+
+} // vmsim_space_create ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+bool
+vmsim_space_switch (int space) {
+
+  vmsim_init();
+  assert(space >= 0 && space < MAX_SPACES && spaces[space].created);
+  if (spaces[space].stats.suspended) {
+    return false;
+  }
+
+  spaces[current_space].sim_free_addr = sim_free_addr;
+  current_space = space;
+  upper_pt      = spaces[space].upper_pt;
+  sim_free_addr = spaces[space].sim_free_addr;
+  mmu_init(upper_pt);
+  return true;
+
+} // vmsim_space_switch ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+int
+vmsim_space_current () {
+
+  return current_space;
+
+} // vmsim_space_current ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_space_suspend (int space) {
+
+  vmsim_init();
+  assert(space >= 0 && space < MAX_SPACES && spaces[space].created);
+  suspend_space(space);
+
+} // vmsim_space_suspend ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_space_resume (int space) {
+
+  vmsim_init();
+  assert(space >= 0 && space < MAX_SPACES && spaces[space].created);
+  resume_space(space);
+
+} // vmsim_space_resume ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_space_set_allotment (int space, uint64_t frames) {
+
+  vmsim_init();
+  assert(space >= 0 && space < MAX_SPACES && spaces[space].created && frames <= fast_frames);
+  spaces[space].stats.allotment = frames;
+
+} // vmsim_space_set_allotment ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_get_space_stats (int space, vmsim_space_stats_t* stats) {
+
+  assert(space >= 0 && space < MAX_SPACES);
+  *stats = spaces[space].stats;
+
+} // vmsim_get_space_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Find the lower PTE for a _simulated_ address in a given space, whether or not it is current.
+ *
+ * \param  space    The space.
+ * \param  sim_addr The _simulated_ address to look up.
+ * \param  create   Whether to create the lower table if it does not exist.
+ * \return the _real_ address of the lower PTE, or 0 if the address has no lower page table and none was created.
+ */
+vmsim_addr_t
+space_lower_pte (int space, vmsim_addr_t sim_addr, bool create) {
+
+  vmsim_addr_t upper_pte_addr = spaces[space].upper_pt + (GET_UPPER_INDEX(sim_addr) * sizeof(pt_entry_t));
+  pt_entry_t   upper_pte;
+  vmsim_read_real(&upper_pte, upper_pte_addr, sizeof(upper_pte));
+  if (upper_pte == 0) {
+    if (!create) {
+      return 0;
+    }
+    upper_pte = allocate_lower_pt(sim_addr);
+    vmsim_write_real(&upper_pte, upper_pte_addr, sizeof(upper_pte));
+  }
+  return GET_PAGE_ADDR(upper_pte) + (GET_LOWER_INDEX(sim_addr) * sizeof(pt_entry_t));
+
+} // space_lower_pte ()
+
+
+
+/**
+ * Discard the page mapped by a lower PTE, pooling its frame and freeing its block, and leave the PTE unmapped.
+ *
+ * \param lower_pte_addr The _real_ address of the lower PTE.
+ */
+void
+release_page (vmsim_addr_t lower_pte_addr) {
+
+  pt_entry_t lower_pte;
+  vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+  if (lower_pte == 0) {
+    return;
+  }
+  if (IS_RESIDENT(lower_pte)) {
+    uint64_t page_no = get_page_no(GET_PAGE_ADDR(lower_pte));
+    assert(pins[page_no] == 0);
+    resolve_prefetch(page_no, false);
+    invalidate_translation(page_no);
+    if (frame_blocks[page_no] != 0) {
+      wb_free(frame_blocks[page_no]);
+    }
+    spaces[owners[page_no]].stats.resident -= 1;
+    class_unlink(page_no);
+    entries[page_no]      = NULL;
+    frame_blocks[page_no] = 0;
+    pc_zero(real_base + frame_addr(page_no));
+    pool_frame(page_no);
+  } else {
+    wb_free(lower_pte >> 10);
+  }
+  lower_pte = 0;
+  vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+
+} // release_page ()
+
+
+
+size_t
+vmsim_move_pages (int src_space, vmsim_addr_t src_addr, int dst_space, vmsim_addr_t dst_addr, size_t npages) {
+
+  vmsim_init();
+  assert(src_space >= 0 && src_space < MAX_SPACES && spaces[src_space].created && !spaces[src_space].stats.suspended);
+  assert(dst_space >= 0 && dst_space < MAX_SPACES && spaces[dst_space].created && !spaces[dst_space].stats.suspended);
+  assert(IS_ALIGNED(src_addr) && IS_ALIGNED(dst_addr) && src_addr != 0 && dst_addr != 0);
+  assert((uint64_t)src_addr + (npages * PAGESIZE) <= ((uint64_t)1 << 32));
+  assert((uint64_t)dst_addr + (npages * PAGESIZE) <= ((uint64_t)1 << 32));
+  assert(src_space != dst_space || src_addr + (npages * PAGESIZE) <= dst_addr || dst_addr + (npages * PAGESIZE) <= src_addr);
+
+  // The destination range must already be allocated in its space, or a later vmsim_alloc() there would hand it out again.
+  vmsim_addr_t dst_free_addr = (dst_space == current_space) ? sim_free_addr : spaces[dst_space].sim_free_addr;
+  assert((uint64_t)dst_addr + (npages * PAGESIZE) <= dst_free_addr);
+
+  // Each page moves by its PTE alone:  a resident page keeps its frame, which follows it to the new PTE and owner, and a
+  // swapped-out page keeps its block, and its shadow entry so that a refault is still recognized.
+  size_t moved = 0;
+  for (size_t i = 0; i < npages; i += 1) {
+
+    vmsim_addr_t src_pte_addr = space_lower_pte(src_space, src_addr + (i * PAGESIZE), false);
+    vmsim_addr_t dst_pte_addr = space_lower_pte(dst_space, dst_addr + (i * PAGESIZE), true);
+    release_page(dst_pte_addr);
+    pt_entry_t lower_pte = 0;
+    if (src_pte_addr != 0) {
+      vmsim_read_real(&lower_pte, src_pte_addr, sizeof(lower_pte));
+    }
+    if (lower_pte == 0) {
+      continue;
+    }
+    vmsim_write_real(&lower_pte, dst_pte_addr, sizeof(lower_pte));
+
+    if (IS_RESIDENT(lower_pte)) {
+      uint64_t page_no = get_page_no(GET_PAGE_ADDR(lower_pte));
+      assert(pins[page_no] == 0);
+      invalidate_translation(page_no);
+      entries[page_no] = (pt_entry_t*)(real_base + dst_pte_addr);
+      owners[page_no]  = dst_space;
+      class_unlink(page_no);
+      frame_classes[page_no] = page_class(dst_space, dst_addr + (i * PAGESIZE));
+      class_link(page_no);
+      spaces[src_space].stats.resident -= 1;
+      spaces[dst_space].stats.resident += 1;
+    } else {
+      uint64_t distance;
+      if (recall_eviction(src_pte_addr, &distance)) {
+        shadow_t* shadow       = &shadows[(dst_pte_addr / sizeof(pt_entry_t)) % SHADOW_ENTRIES];
+        shadow->lower_pte_addr = dst_pte_addr;
+        shadow->evicted_at     = eviction_clock - distance;
+      }
+    }
+    lower_pte = 0;
+    vmsim_write_real(&lower_pte, src_pte_addr, sizeof(lower_pte));
+    moved += 1;
+
+  }
+  return moved;
+
+} // vmsim_move_pages ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_numa_set_home (int node) {
+
+  vmsim_init();
+  assert(node >= 0 && node < numa_nodes);
+  home_node = node;
+
+} // vmsim_numa_set_home ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_numa_set_policy (int policy, int node) {
+
+  vmsim_init();
+  assert(policy == VMSIM_NUMA_FIRST_TOUCH || policy == VMSIM_NUMA_INTERLEAVE || policy == VMSIM_NUMA_BIND);
+  assert(policy != VMSIM_NUMA_BIND || (node >= 0 && node < numa_nodes));
+  numa_policy = policy;
+  bind_node   = (policy == VMSIM_NUMA_BIND) ? node : 0;
+
+} // vmsim_numa_set_policy ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+int
+vmsim_page_colors () {
+
+  vmsim_init();
+  return page_colors;
+
+} // vmsim_page_colors ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_space_set_colors (int space, int first, int count) {
+
+  vmsim_init();
+  assert(space >= 0 && space < MAX_SPACES && spaces[space].created);
+  assert(first >= 0 && count > 0 && first + count <= page_colors);
+  spaces[space].color_first = first;
+  spaces[space].color_count = count;
+  spaces[space].color_next  = 0;
+
+} // vmsim_space_set_colors ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_get_color_occupancy (int space, uint64_t* occupancy) {
+
+  vmsim_init();
+  memset(occupancy, 0, sizeof(uint64_t) * page_colors);
+  for (uint64_t i = 0; i < fast_frames; i += 1) {
+    if (entries[i] != NULL && (space < 0 || owners[i] == space)) {
+      occupancy[color_of(i)] += 1;
+    }
+  }
+
+} // vmsim_get_color_occupancy ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_get_numa_stats (vmsim_numa_stats_t* stats) {
+
+  *stats = numa_stats;
+
+} // vmsim_get_numa_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+bool
+vmsim_compact (size_t pages) {
+
+  vmsim_init();
+  compaction_stats.requests += 1;
+  return compact_frames(place_page(), pages, false) != NO_FRAME;
+
+} // vmsim_compact ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_get_compaction_stats (vmsim_compaction_stats_t* stats) {
+
+  vmsim_init();
+  *stats = compaction_stats;
+  find_free_run(0, fast_frames, NO_FRAME, &stats->largest_free_run);
+
+} // vmsim_get_compaction_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * Fault in, if need be, and pin the page holding a _simulated_ address of a copy's space, recording it against the copy.  The page
+ * is reached through that space's own page tables, so the current space, whose access may be driving the copy, is left alone, and
+ * the fault is counted against the copy's space.
+ *
+ * \param  copy            The copy for which the page is pinned.
+ * \param  sim_addr        The _simulated_ address.
+ * \param  write_operation Whether the copy writes the page.
+ * \return a pointer to the byte at that address in real memory.
+ */
+uint8_t*
+pin_page (copy_t* copy, vmsim_addr_t sim_addr, bool write_operation) {
+
+  vmsim_addr_t lower_pte_addr = space_lower_pte(copy->space, sim_addr, true);
+  pt_entry_t   lower_pte;
+  vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+  if (!IS_RESIDENT(lower_pte)) {
+    vmsim_addr_t frame = allocate_real_page(lower_pte_addr, copy->space);
+    if (lower_pte == 0) {
+      map_frame(lower_pte_addr, frame, copy->space);
+      fill_from_pager(lower_pte_addr, frame, copy->space);
+      fault_stats.first_touch += 1;
+    } else {
+      wb_read(frame, (lower_pte & 0xfffffc00) >> 10);
+      install_page(lower_pte_addr, frame, copy->space);
+      fault_stats.swap_ins += 1;
+    }
+    fault_stats.faults                += 1;
+    spaces[copy->space].stats.faults  += 1;
+    spaces[copy->space].window_faults += 1;
+    vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+  }
+  SET_REFERENCED(lower_pte);
+  if (write_operation) {
+    SET_DIRTY(lower_pte);
+  }
+  vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+
+  vmsim_addr_t real_addr = GET_PAGE_ADDR(lower_pte) | GET_OFFSET(sim_addr);
+  uint64_t     page_no   = get_page_no(real_addr);
+  if (page_no < fast_frames) {
+    bin_pins[bin_of(page_no)] += 1;
+  }
+  pins[page_no]                      += 1;
+  pinned_frames                      += 1;
+  copy->pinned[copy->pinned_count++]  = page_no;
+  copy_stats.pinned_pages            += 1;
+  return (uint8_t*)real_base + real_addr;
+
+} // pin_page ()
+
+
+
+/**
+ * Pin the pages of a copy's next chunk and hand it to the copy engine.  The chunk is cut into pieces at the page boundaries of both
+ * ranges, and ends early if the pinning limit is reached.
+ *
+ * \param copy The copy, which must have bytes left to issue and no chunk pending.
+ */
+void
+start_chunk (copy_t* copy) {
+
+  dma_piece_t pieces[2 * COPY_CHUNK_PAGES];
+  size_t      count = 0;
+  copy->pinned_count = 0;
+  while (copy->issued < copy->len && count < 2 * COPY_CHUNK_PAGES && pinned_frames + 2 <= max_pinned) {
+    vmsim_addr_t src  = copy->src + copy->issued;
+    vmsim_addr_t dst  = copy->dst + copy->issued;
+    size_t       size = copy->len - copy->issued;
+    if (size > PAGESIZE - GET_OFFSET(src)) {
+      size = PAGESIZE - GET_OFFSET(src);
+    }
+    if (size > PAGESIZE - GET_OFFSET(dst)) {
+      size = PAGESIZE - GET_OFFSET(dst);
+    }
+    pieces[count].src   = pin_page(copy, src, false);
+    pieces[count].dst   = pin_page(copy, dst, true);
+    pieces[count].size  = size;
+    count              += 1;
+    copy->issued       += size;
+    copy_stats.bytes   += size;
+  }
+  if (count == 0) {
+    copy_stats.stalls += 1;
+    return;
+  }
+  pg_flush();
+  copy->ticket       = dma_submit(pieces, count);
+  copy->pending      = true;
+  copy_stats.chunks += 1;
+
+} // start_chunk ()
+
+
+
+/**
+ * Unpin the pages of a copy's pending chunk if the copy engine has finished with it.
+ *
+ * \param copy The copy.
+ */
+void
+reap_chunk (copy_t* copy) {
+
+  if (!copy->pending || !dma_complete(copy->ticket)) {
+    return;
+  }
+  for (size_t i = 0; i < copy->pinned_count; i += 1) {
+    pins[copy->pinned[i]] -= 1;
+    if (copy->pinned[i] < fast_frames) {
+      bin_pins[bin_of(copy->pinned[i])] -= 1;
+    }
+  }
+  pinned_frames      -= copy->pinned_count;
+  copy->pinned_count  = 0;
+  copy->pending       = false;
+
+} // reap_chunk ()
+
+
+
+/**
+ * Advance a copy:  reap its pending chunk if it is done, and if it then has none, start the next.
+ *
+ * \param  copy The copy.
+ * \return whether the copy is complete.
+ */
+bool
+advance_copy (copy_t* copy) {
+
+  reap_chunk(copy);
+  if (!copy->pending && copy->issued < copy->len) {
+    start_chunk(copy);
+  }
+  return !copy->pending && copy->issued == copy->len;
+
+} // advance_copy ()
+
+
+
+/**
+ * Advance every copy in progress, after an access.
+ */
+void
+copy_tick () {
+
+  for (int i = 0; i < MAX_COPIES; i += 1) {
+    if (copies[i].in_use) {
+      advance_copy(&copies[i]);
+    }
+  }
+
+} // copy_tick ()
+
+
+
+/**
+ * Release the handle of a complete copy.
+ */
+void
+release_copy (copy_t* copy) {
+
+  copy->in_use                 = false;
+  spaces[copy->space].copies  -= 1;
+  active_copies               -= 1;
+  copy_stats.completed        += 1;
+
+} // release_copy ()
+
+
+
+vmsim_copy_t
+vmsim_memcpy_async (vmsim_addr_t dst, vmsim_addr_t src, size_t len) {
+
+  vmsim_init();
+  assert((uint64_t)src + len <= dst || (uint64_t)dst + len <= src);
+  int handle = 0;
+  while (handle < MAX_COPIES && copies[handle].in_use) {
+    handle += 1;
+  }
+  assert(handle < MAX_COPIES);
+
+  copy_t* copy  = &copies[handle];
+  copy->in_use  = true;
+  copy->pending = false;
+  copy->space   = current_space;
+  copy->dst     = dst;
+  copy->src     = src;
+  copy->len     = len;
+  copy->issued  = 0;
+  spaces[current_space].copies += 1;
+  active_copies                += 1;
+  copy_stats.copies            += 1;
+  advance_copy(copy);
+  return handle;
+
+} // vmsim_memcpy_async ()
+
+
+
+bool
+vmsim_memcpy_test (vmsim_copy_t handle) {
+
+  assert(handle >= 0 && handle < MAX_COPIES && copies[handle].in_use);
+  if (!advance_copy(&copies[handle])) {
+    return false;
+  }
+  release_copy(&copies[handle]);
+  return true;
+
+} // vmsim_memcpy_test ()
+
+
+
+void
+vmsim_memcpy_wait (vmsim_copy_t handle) {
+
+  assert(handle >= 0 && handle < MAX_COPIES && copies[handle].in_use);
+  copy_t* copy = &copies[handle];
+  while (!advance_copy(copy)) {
+
+    if (copy->pending) {
+      copy_stats.waits += 1;
+      dma_wait(copy->ticket);
+      continue;
+    }
+
+    // Other copies hold every pin that may be taken, so wait for their chunks, and reap them without starting more.
+    for (int i = 0; i < MAX_COPIES; i += 1) {
+      if (copies[i].in_use && copies[i].pending) {
+        copy_stats.waits += 1;
+        dma_wait(copies[i].ticket);
+        reap_chunk(&copies[i]);
+      }
+    }
+
+  }
+  release_copy(copy);
+
+} // vmsim_memcpy_wait ()
+
+
+
+void
+vmsim_get_copy_stats (vmsim_copy_stats_t* stats) {
+
+  *stats = copy_stats;
+
+} // vmsim_get_copy_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+int
+vmsim_register_pager (vmsim_addr_t addr, size_t size, const vmsim_pager_ops_t* ops) {
+
+  vmsim_init();
+  return pg_register(current_space, addr, size, ops);
+
+} // vmsim_register_pager ()
+
+
+
+void
+vmsim_get_pager_stats (vmsim_pager_stats_t* stats) {
+
+  pg_get_stats(stats);
+
+} // vmsim_get_pager_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_set_class (vmsim_addr_t addr, size_t size, int qos_class) {
+
+  vmsim_init();
+  assert(qos_class >= 0 && qos_class < VMSIM_QOS_CLASSES && size > 0 && (uint64_t)addr + size <= ((uint64_t)1 << 32));
+
+  qos_active = true;
+
+  // Record the class of each page in the range, and move its resident pages into the ring of their new class.
+  for (uint64_t page = GET_PAGE_ADDR(addr); page < (uint64_t)addr + size; page += PAGESIZE) {
+    uint8_t** classes = &spaces[current_space].class_tables[GET_UPPER_INDEX((vmsim_addr_t)page)];
+    if (*classes == NULL) {
+      *classes = malloc(PT_ENTRIES);
+      assert(*classes != NULL);
+      memset(*classes, VMSIM_QOS_NORMAL, PT_ENTRIES);
+    }
+    (*classes)[GET_LOWER_INDEX((vmsim_addr_t)page)] = qos_class;
+
+    vmsim_addr_t lower_pte_addr = lookup_lower_pte(page);
+    pt_entry_t   lower_pte      = 0;
+    if (lower_pte_addr != 0) {
+      vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    }
+    if (IS_RESIDENT(lower_pte)) {
+      uint64_t page_no = get_page_no(GET_PAGE_ADDR(lower_pte));
+      class_unlink(page_no);
+      frame_classes[page_no] = qos_class;
+      class_link(page_no);
+    }
+  }
+
+} // vmsim_set_class ()
+
+
+
+void
+vmsim_set_class_reserve (int qos_class, size_t pages) {
+
+  vmsim_init();
+  assert(qos_class >= 0 && qos_class < VMSIM_QOS_CLASSES);
+  class_reserves[qos_class] = pages;
+
+} // vmsim_set_class_reserve ()
+
+
+
+void
+vmsim_get_qos_stats (vmsim_qos_stats_t* stats) {
+
+  *stats = qos_stats;
+  for (int i = 0; i < VMSIM_QOS_CLASSES; i += 1) {
+    stats->resident[i] = class_frames[i];
+  }
+
+} // vmsim_get_qos_stats ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_read (void* buffer, vmsim_addr_t addr, size_t size) {
+
+  vmsim_addr_t real_addr = vmsim_map(addr, false);
+  charge_access(real_addr);
+  if (cache_modeling) {
+    cm_access(current_space, addr, real_addr, size);
+  }
+  vmsim_read_real(buffer, real_addr, size);
+  if (numa_balancing) {
+    balance_tick(real_addr);
+  }
+  if (monitoring) {
+    mon_tick(current_space, sim_free_addr);
+  }
+  if (reclaim_interval != 0) {
+    reclaim_tick();
+  }
+  if (compact_interval != 0) {
+    compact_tick();
+  }
+  if (active_copies > 0) {
+    copy_tick();
+  }
+  load_tick();
+
+} // vmsim_read ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+vmsim_write (void* buffer, vmsim_addr_t addr, size_t size) {
+
+  vmsim_addr_t real_addr = vmsim_map(addr, true);
+  charge_access(real_addr);
+  if (cache_modeling) {
+    cm_access(current_space, addr, real_addr, size);
+  }
+  vmsim_write_real(buffer, real_addr, size);
+  if (numa_balancing) {
+    balance_tick(real_addr);
+  }
+  if (monitoring) {
+    mon_tick(current_space, sim_free_addr);
+  }
+  if (reclaim_interval != 0) {
+    reclaim_tick();
+  }
+  if (compact_interval != 0) {
+    compact_tick();
+  }
+  if (active_copies > 0) {
+    copy_tick();
+  }
+  load_tick();
+
+} // vmsim_write ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+vmsim_addr_t
+vmsim_alloc (size_t size) {
+
+  return vmsim_alloc_flags(size, 0);
+  
+} // vmsim_alloc ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+vmsim_addr_t
+vmsim_alloc_flags (size_t size, int flags) {
+
+  vmsim_init();
+
+  // Pointer-bumping allocator with no reclamation.
+  vmsim_addr_t addr = sim_free_addr;
+  sim_free_addr += size;
+
+  if (CLASS_OF_FLAGS(flags) >= 0 && size > 0) {
+    vmsim_set_class(addr, size, CLASS_OF_FLAGS(flags));
+  }
+  if (flags & VMSIM_POPULATE) {
+    vmsim_prefault(addr, size, flags & ~VMSIM_POPULATE);
+  }
+  return addr;
+  
+} // vmsim_alloc_flags ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+/**
+ * \return the _real_ base address of the lower table covering a _simulated_ address, creating the table if needed.
+ */
+vmsim_addr_t
+ensure_lower_pt (vmsim_addr_t sim_addr) {
+
+  vmsim_addr_t upper_pte_addr = upper_pt + (GET_UPPER_INDEX(sim_addr) * sizeof(pt_entry_t));
+  pt_entry_t   upper_pte;
+  vmsim_read_real(&upper_pte, upper_pte_addr, sizeof(upper_pte));
+  if (upper_pte == 0) {
+    upper_pte = allocate_lower_pt(sim_addr);
+    vmsim_write_real(&upper_pte, upper_pte_addr, sizeof(upper_pte));
+  }
+  return GET_PAGE_ADDR(upper_pte);
+  
+} // ensure_lower_pt ()
+// =================================================================================================================================
+
+
 
 // =================================================================================================================================
 /**
- * Allocate a page of real memory space for a page table block.  Taken from a region of real memory reserved for this purpose.
- *
- * \return The _real_ base address of a page of memory for a page table block.
+ * \return the number of frames that have never been used, and so can be filled without evicting anything.
  */
-vmsim_addr_t
-allocate_pt () {
+uint64_t
+free_frame_count () {
 
-  vmsim_addr_t new_pt_addr = pt_free_addr;
-  pt_free_addr += PAGESIZE;
-  assert(IS_ALIGNED(new_pt_addr));
-  assert(pt_free_addr <= PT_AREA_SIZE);
-  void* new_pt_ptr = (void*)(real_base + new_pt_addr);
-  memset(new_pt_ptr, 0, PAGESIZE);
-  
-  return new_pt_addr;
+  uint64_t free_frames = slow_pool_count;
+  for (int bin = 0; bin < bin_count; bin += 1) {
+    free_frames += bin_counts[bin];
+  }
+  if (real_free_addr < frame_addr(fast_frames)) {
+    free_frames += (frame_addr(fast_frames) - real_free_addr) / PAGESIZE;
+  }
+  if (slow_size != 0 && slow_free_addr < frame_addr(ENTRIES_LENGTH)) {
+    free_frames += (frame_addr(ENTRIES_LENGTH) - slow_free_addr) / PAGESIZE;
+  }
+  return free_frames;
   
-} // allocate_pt ()
+} // free_frame_count ()
 // =================================================================================================================================
 
 
 
 // =================================================================================================================================
 /**
- * Allocate a page of real memory space for backing a simulated page.  Taken from the general pool of real memory.
+ * Back the unmapped pages of a range, in address order, with one run of contiguous fast-tier frames on the placement policy's node,
+ * compacting the node to build the run if need be.  Every lower table the range needs must exist.
  *
- * \return The _real_ base address of a page of memory.
+ * \param  first_page The _simulated_ address of the first page of the range.
+ * \param  last_page  The _simulated_ address of the last page of the range.
+ * \param  mapped     Where to store the number of pages mapped.
+ * \return whether the run could be built; if not, nothing is mapped.
  */
-vmsim_addr_t
-allocate_real_page () {
+bool
+prefault_contiguous (vmsim_addr_t first_page, vmsim_addr_t last_page, size_t* mapped) {
 
-  vmsim_addr_t new_real_addr = real_free_addr;
-  real_free_addr += PAGESIZE;
-  assert(IS_ALIGNED(new_real_addr));
-  //assert(real_free_addr <= real_size); //TODO: change me!
-  if (real_free_addr > real_size){    //out of space?
-    if(!overflowed){//DEBUG: tell me if we have overflowed onto BS
-      overflowed = true;
-      //show_entries();
+  uint64_t count = 0;
+  *mapped = 0;
+  for (uint64_t page = first_page; page <= last_page; page += PAGESIZE) {
+    vmsim_addr_t lower_pte_addr = ensure_lower_pt(page) + (GET_LOWER_INDEX((vmsim_addr_t)page) * sizeof(pt_entry_t));
+    pt_entry_t   lower_pte;
+    vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    count += (lower_pte == 0 && page != 0);
+  }
+  if (count == 0) {
+    return true;
+  }
+
+  compaction_stats.requests += 1;
+  int      node = place_page();
+  uint64_t run  = compact_frames(node, count, true);
+  if (run == NO_FRAME) {
+    return false;
+  }
+  for (uint64_t page = first_page; page <= last_page; page += PAGESIZE) {
+    vmsim_addr_t lower_pte_addr = ensure_lower_pt(page) + (GET_LOWER_INDEX((vmsim_addr_t)page) * sizeof(pt_entry_t));
+    pt_entry_t   lower_pte;
+    vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    if (lower_pte == 0 && page != 0) {
+      claim_frame(run);
+      map_frame(lower_pte_addr, frame_addr(run), current_space);
+      fill_from_pager(lower_pte_addr, frame_addr(run), current_space);
+      run     += 1;
+      *mapped += 1;
     }
-    pt_entry_t* to_bs = search();      //find the lpt entry for a NRU page
-    vmsim_addr_t real_page_addr = move_to_bs(to_bs);     //move that entry's contents to BS and give the newly freed page.
-    return real_page_addr;            //return the address of the freed page.
   }
-    
-  void* new_real_ptr = (void*)(real_base + new_real_addr);
-  memset(new_real_ptr, 0, PAGESIZE);
+  pg_flush();
+  numa_stats.allocations[node]     += count;
+  compaction_stats.contiguous_pages += count;
+  return true;
 
-  return new_real_addr;
-  
-} // allocate_real_page ()
+} // prefault_contiguous ()
 // =================================================================================================================================
 
 
 
 // =================================================================================================================================
-void
-vmsim_init () {
+size_t
+vmsim_prefault (vmsim_addr_t addr, size_t size, int flags) {
 
-  // Only initialize if it hasn't already happened.
-  if (real_base == NULL) {
+  vmsim_init();
+  if (size == 0) {
+    return 0;
+  }
 
-    // Determine the real memory size, preferrably by environment variable, otherwise use the default.
-    char* real_size_envvar = getenv("VMSIM_REAL_MEM_SIZE");
-    if (real_size_envvar != NULL) {
-      errno = 0;
-      real_size = strtoul(real_size_envvar, NULL, 10);
-      assert(errno == 0);
-    }
+  // Create every lower table the range needs up front.
+  vmsim_addr_t first_page = GET_PAGE_ADDR(addr);
+  vmsim_addr_t last_page  = GET_PAGE_ADDR((vmsim_addr_t)(addr + size - 1));
+  for (uint64_t table = GET_UPPER_INDEX(first_page); table <= GET_UPPER_INDEX(last_page); table += 1) {
+    ensure_lower_pt(table << 22);
+  }
+  size_t mapped = 0;
+  if ((flags & VMSIM_PREFAULT_CONTIGUOUS) && prefault_contiguous(first_page, last_page, &mapped)) {
+    return mapped;
+  }
 
-    // Map the real storage space.
-    real_base = mmap(NULL, real_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    assert(real_base != NULL);
-    real_limit = (void*)((intptr_t)real_base + real_size);
-    upper_pt = allocate_pt();
+  // Fill the free frames first.  The pages that do not fit are given zeroed blocks directly, allocated in order so that they lie
+  // in backing-store order, and written in large batches instead of cycling through a frame each.  A page that a pager covers has
+  // no block to go to, so if it does not fit it is left for the pager to fill when it is touched.
+  static const uint8_t zero_page[PAGESIZE];
+  const void*  pages[PREFAULT_BATCH];
+  unsigned int blocks[PREFAULT_BATCH];
+  size_t       batched     = 0;
+  uint64_t     free_frames = free_frame_count();
+  for (uint64_t page = first_page; page <= last_page; page += PAGESIZE) {
 
-    // Initialize the simualted space allocator.  Leave page 0 unused, start at page 1.
-    sim_free_addr = PAGESIZE;
+    vmsim_addr_t lower_pte_addr = ensure_lower_pt(page) + (GET_LOWER_INDEX((vmsim_addr_t)page) * sizeof(pt_entry_t));
+    pt_entry_t   lower_pte;
+    vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    if (lower_pte != 0 || page == 0) {
+      continue;
+    }
 
-    // Initialize the supporting components.
-    mmu_init(upper_pt);
-    bs_init();
+    if (free_frames > 0) {
+      map_new_page(lower_pte_addr);
+      free_frames -= 1;
+    } else if (flags & VMSIM_PREFAULT_FIT) {
+      break;
+    } else if (pg_find(current_space, page) != -1) {
+      continue;
+    } else {
+      unsigned int block_no = bs_alloc_block();
+      assert(block_no != 0);
+      lower_pte = block_no << 10;
+      vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+      pages[batched]  = zero_page;
+      blocks[batched] = block_no;
+      batched        += 1;
+      if (batched == PREFAULT_BATCH) {
+        bs_write_batch(pages, blocks, batched);
+        batched = 0;
+      }
+    }
+    mapped += 1;
 
-    // Initialize the lpt entry array.
-    ENTRIES_LENGTH = (real_size - PT_AREA_SIZE) / PAGESIZE;
-    entries = malloc(sizeof(vmsim_addr_t) * ENTRIES_LENGTH);
-    
   }
+  if (batched > 0) {
+    bs_write_batch(pages, blocks, batched);
+  }
+  pg_flush();
+
+  return mapped;
   
-} // vmsim_init ()
+} // vmsim_prefault ()
 // =================================================================================================================================
 
 
 
 // =================================================================================================================================
 /**
- * Map a _simulated_ address to a _real_ one, ensuring first that the page table and real spaces are initialized.
- *
- * \param  sim_addr        The _simulated_ address to translate.
- * \param  write_operation Whether the memory access is to _read_ (`false`) or to _write_ (`true`).
- * \return the translated _real_ address.
- */ 
-vmsim_addr_t
-vmsim_map (vmsim_addr_t sim_addr, bool write_operation) {
+ * The pending backing-store transfers of one import or export, issued as a batch once `STREAM_BATCH` have gathered.
+ */
+typedef struct {
+  bool         import;
+  size_t       count;
+  void*        pages[STREAM_BATCH];
+  unsigned int blocks[STREAM_BATCH];
+  uint64_t     free_frames;
+} stream_t;
 
-  vmsim_init();
 
-  assert(real_base != NULL);
-  vmsim_addr_t real_addr = mmu_translate(sim_addr, write_operation);
-  return real_addr;
-  
-} // vmsim_map ()
-// =================================================================================================================================
+
+/**
+ * Issue a stream's pending backing-store transfers, and deliver the pager traffic it has queued.
+ */
+void
+flush_stream (stream_t* stream) {
+
+  pg_flush();
+  if (stream->count == 0) {
+    return;
+  }
+  bool success = (stream->import ?
+                  wb_write_batch((const void* const*)stream->pages, stream->blocks, stream->count) :
+                  wb_read_batch(stream->pages, stream->blocks, stream->count));
+  assert(success);
+  stream->count = 0;
+
+} // flush_stream ()
 
 
 
-// =================================================================================================================================
 /**
- * Called when the translation of a _simulated_ address fails.  When this function is done, a _real_ page will back the _simulated_
- * one that contains the given address, with the page tables appropriately updated.
- *
- * \param sim_addr The _simulated_ address for which address translation failed.
+ * Queue one block transfer, issuing the batch if it is full.
  */
 void
-vmsim_map_fault (vmsim_addr_t sim_addr) {
+queue_stream (stream_t* stream, void* host, unsigned int block_no) {
 
-  assert(upper_pt != 0);
+  stream->pages[stream->count]  = host;
+  stream->blocks[stream->count] = block_no;
+  stream->count                += 1;
+  if (stream->count == STREAM_BATCH) {
+    flush_stream(stream);
+  }
 
-  // Grab the upper table's entry.
-  vmsim_addr_t upper_index    = GET_UPPER_INDEX(sim_addr);
-  vmsim_addr_t upper_pte_addr = upper_pt + (upper_index * sizeof(pt_entry_t));
-  pt_entry_t   upper_pte;
-  vmsim_read_real(&upper_pte, upper_pte_addr, sizeof(upper_pte));
+} // queue_stream ()
 
-  // If the lower table doesn't exist, create it and update the upper table.
-  if (upper_pte == 0) {
 
-    upper_pte = allocate_pt();
-    assert(upper_pte != 0);
-    vmsim_write_real(&upper_pte, upper_pte_addr, sizeof(upper_pte));
-    
+
+/**
+ * Copy one whole _simulated_ page into or out of host memory without faulting it in.  A resident page is copied through its frame.
+ * A non-resident page is copied to or from its block directly.  On import, an unmapped page takes an unused frame while any
+ * remain, and is otherwise given a new block and left non-resident, or handed straight to its pager if one covers it; on export,
+ * an unmapped page is filled by its pager, or reads as zeros.
+ *
+ * \param  stream The stream to which the page belongs.
+ * \param  page   The _simulated_ base address of the page.
+ * \param  host   The page's data in host memory, which must remain valid until the stream is flushed.
+ */
+void
+stream_page (stream_t* stream, vmsim_addr_t page, uint8_t* host) {
+
+  vmsim_addr_t lower_pte_addr = (stream->import ?
+                                 ensure_lower_pt(page) + (GET_LOWER_INDEX(page) * sizeof(pt_entry_t)) :
+                                 lookup_lower_pte(page));
+  pt_entry_t   lower_pte      = 0;
+  if (lower_pte_addr != 0) {
+    vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
   }
+  int          pager          = (lower_pte == 0) ? pg_find(current_space, page) : -1;
 
-  // Grab the lower table's entry.
-  vmsim_addr_t lower_pt       = GET_PAGE_ADDR(upper_pte);
-  vmsim_addr_t lower_index    = GET_LOWER_INDEX(sim_addr);
-  vmsim_addr_t lower_pte_addr = lower_pt + (lower_index * sizeof(pt_entry_t));
-  pt_entry_t   lower_pte;
-  vmsim_read_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+  if (IS_RESIDENT(lower_pte)) {
+    if (stream->import) {
+      vmsim_write_real(host, GET_PAGE_ADDR(lower_pte), PAGESIZE);
+      SET_DIRTY(lower_pte);
+      vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    } else {
+      vmsim_read_real(host, GET_PAGE_ADDR(lower_pte), PAGESIZE);
+    }
+  } else if (lower_pte != 0) {
+    queue_stream(stream, host, (lower_pte & 0xfffffc00) >> 10);
+  } else if (!stream->import && pager != -1) {
+    pg_fill(pager, page, host);
+  } else if (!stream->import) {
+    memset(host, 0, PAGESIZE);
+  } else if (stream->free_frames > 0) {
+    // The page is overwritten whole, so it needs no fill, but is dirty so that a pager gets it back.
+    lower_pte = map_frame(lower_pte_addr, allocate_real_page(lower_pte_addr, current_space), current_space);
+    vmsim_write_real(host, GET_PAGE_ADDR(lower_pte), PAGESIZE);
+    SET_DIRTY(lower_pte);
+    vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    stream->free_frames -= 1;
+  } else if (pager != -1) {
+    pg_writeback(pager, page, host);
+  } else {
+    unsigned int block_no = bs_alloc_block();
+    assert(block_no != 0);
+    lower_pte = block_no << 10;
+    vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(lower_pte));
+    queue_stream(stream, host, block_no);
+  }
 
-  // If there is no mapped page, create it and update the lower table.
-  if (lower_pte == 0) {
+} // stream_page ()
 
-    lower_pte = allocate_real_page();
-    vmsim_addr_t real_addr = lower_pte;
-    SET_RESIDENT(lower_pte);
-    vmsim_write_real(&lower_pte, lower_pte_addr, sizeof(pt_entry_t));
-    
-    //record pointer to lower pte in entries
-    entries[get_page_no(real_addr)] = (pt_entry_t*)(lower_pte_addr + real_base);
 
-    //DEBUG: update last pte
-    last_pte = &lower_pte;
 
+/**
+ * Import or export a range of _simulated_ space.  Whole pages are streamed directly; a partially covered page at either end is
+ * first exported whole, so that an import can merge its new bytes and write the page back whole.
+ */
+void
+stream_range (uint8_t* buffer, vmsim_addr_t addr, size_t size, bool import) {
+
+  vmsim_init();
+  static uint8_t edges[2][PAGESIZE];
+  stream_t stream = { .import = import, .count = 0, .free_frames = import ? free_frame_count() : 0 };
+  size_t   done   = 0;
+  while (done < size) {
+
+    vmsim_addr_t page   = GET_PAGE_ADDR((vmsim_addr_t)(addr + done));
+    size_t       offset = (addr + done) - page;
+    size_t       length = (PAGESIZE - offset < size - done) ? PAGESIZE - offset : size - done;
+    if (length == PAGESIZE) {
+      stream_page(&stream, page, buffer + done);
+    } else {
+      uint8_t* edge = edges[(done == 0) ? 0 : 1];
+      stream_t whole = { .import = false, .count = 0 };
+      stream_page(&whole, page, edge);
+      flush_stream(&whole);
+      if (import) {
+        memcpy(edge + offset, buffer + done, length);
+        stream_page(&stream, page, edge);
+      } else {
+        memcpy(buffer + done, edge + offset, length);
+      }
+    }
+    done += length;
 
-  }  
-  //unsigned int test = IS_RESIDENT(lower_pte);
-  //printf("%u", test);
-  //printf("%u", ~IS_RESIDENT(lower_pte));
-  //fflush(stdout);
-  if (IS_RESIDENT(lower_pte)==0){//if it is not resident, we need to swap it in
-    pt_entry_t* out = search();
-    swap(lower_pte_addr, out);
   }
-    
-  
-} // vmsim_map_fault ()
+  flush_stream(&stream);
+
+} // stream_range ()
 // =================================================================================================================================
 
 
 
 // =================================================================================================================================
 void
-vmsim_read_real (void* buffer, vmsim_addr_t real_addr, size_t size) {
+vmsim_import (const void* buffer, vmsim_addr_t addr, size_t size) {
 
-  // Get a pointer into the real space and check the bounds.
-  void* ptr = real_base + real_addr;
-  void* end = (void*)((intptr_t)ptr + size);
-  assert(end <= real_limit);
+  stream_range((uint8_t*)buffer, addr, size, true);
 
-  // Copy the requested bytes from the real space.
-  memcpy(buffer, ptr, size);
-  
-} // vmsim_read_real ()
+} // vmsim_import ()
 // =================================================================================================================================
 
 
 
 // =================================================================================================================================
 void
-vmsim_write_real (void* buffer, vmsim_addr_t real_addr, size_t size) {
+vmsim_export (void* buffer, vmsim_addr_t addr, size_t size) {
 
-  // Get a pointer into the real space and check the bounds.
-  void* ptr = real_base + real_addr;
-  void* end = (void*)((intptr_t)ptr + size);
-  assert(end <= real_limit);
+  stream_range(buffer, addr, size, false);
 
-  // Copy the requested bytes into the real space.
-  memcpy(ptr, buffer, size);
-  
-} // vmsim_write_real ()
+} // vmsim_export ()
 // =================================================================================================================================
 
 
 
 // =================================================================================================================================
-void
-vmsim_read (void* buffer, vmsim_addr_t addr, size_t size) {
+size_t
+vmsim_import_fd (int fd, vmsim_addr_t addr, size_t size) {
 
-  vmsim_addr_t real_addr = vmsim_map(addr, false);
-  vmsim_read_real(buffer, real_addr, size);
+  // Stage the file through host memory a batch of pages at a time, keeping each chunk aligned to the simulated pages.
+  static uint8_t chunk[STREAM_BATCH * PAGESIZE];
+  size_t done = 0;
+  while (done < size) {
 
-} // vmsim_read ()
+    size_t want = STREAM_BATCH * PAGESIZE - ((addr + done) % PAGESIZE);
+    if (want > size - done) {
+      want = size - done;
+    }
+    size_t got = 0;
+    while (got < want) {
+      ssize_t result = read(fd, chunk + got, want - got);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result <= 0) {
+        break;
+      }
+      got += result;
+    }
+    vmsim_import(chunk, addr + done, got);
+    done += got;
+    if (got < want) {
+      break;
+    }
+
+  }
+  return done;
+
+} // vmsim_import_fd ()
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+size_t
+vmsim_export_fd (int fd, vmsim_addr_t addr, size_t size) {
+
+  static uint8_t chunk[STREAM_BATCH * PAGESIZE];
+  size_t done = 0;
+  while (done < size) {
+
+    size_t want = STREAM_BATCH * PAGESIZE - ((addr + done) % PAGESIZE);
+    if (want > size - done) {
+      want = size - done;
+    }
+    vmsim_export(chunk, addr + done, want);
+    size_t put = 0;
+    while (put < want) {
+      ssize_t result = write(fd, chunk + put, want - put);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result <= 0) {
+        return done + put;
+      }
+      put += result;
+    }
+    done += want;
+
+  }
+  return done;
+
+} // vmsim_export_fd ()
 // =================================================================================================================================
 
 
 
 // =================================================================================================================================
+/**
+ * Evict the page held in a frame to the backing store, leaving the frame unowned and zeroed.
+ *
+ * \param page_no The number of a frame that holds a page.
+ */
 void
-vmsim_write (void* buffer, vmsim_addr_t addr, size_t size) {
+evict_frame (uint64_t page_no) {
 
-  vmsim_addr_t real_addr = vmsim_map(addr, true);
-  vmsim_write_real(buffer, real_addr, size);
+  resolve_prefetch(page_no, false);
+  move_to_bs(entries[page_no]);
+  entries[page_no] = NULL;
 
-} // vmsim_write ()
+} // evict_frame ()
+
+
+
+/**
+ * Resize the frame table to a new number of frames, rebasing its pointers onto a possibly moved real memory.  New frames start
+ * unowned.
+ */
+void
+resize_frame_table (uint64_t new_length, void* old_base) {
+
+  for (uint64_t i = 0; i < ENTRIES_LENGTH && i < new_length; i += 1) {
+    if (entries[i] != NULL) {
+      entries[i] = (pt_entry_t*)(real_base + ((void*)entries[i] - old_base));
+    }
+  }
+  entries      = realloc(entries,      sizeof(pt_entry_t*)  * new_length);
+  histories    = realloc(histories,    sizeof(uint8_t)      * new_length);
+  frame_blocks = realloc(frame_blocks, sizeof(unsigned int) * new_length);
+  prefetched   = realloc(prefetched,   sizeof(bool)         * new_length);
+  idle_ages    = realloc(idle_ages,    sizeof(uint16_t)     * new_length);
+  free_pool    = realloc(free_pool,    sizeof(uint64_t)     * new_length);
+  owners       = realloc(owners,       sizeof(uint8_t)      * new_length);
+  hint_nodes   = realloc(hint_nodes,   sizeof(uint8_t)      * new_length);
+  pins         = realloc(pins,         sizeof(uint16_t)     * new_length);
+  frame_classes = realloc(frame_classes, sizeof(uint8_t)    * new_length);
+  class_next    = realloc(class_next,    sizeof(uint64_t)   * new_length);
+  class_prev    = realloc(class_prev,    sizeof(uint64_t)   * new_length);
+  frame_rings   = realloc(frame_rings,   sizeof(uint8_t)    * new_length);
+  assert(entries != NULL && histories != NULL && frame_blocks != NULL && prefetched != NULL);
+  assert(idle_ages != NULL && free_pool != NULL && owners != NULL && hint_nodes != NULL && pins != NULL);
+  assert(frame_classes != NULL && class_next != NULL && class_prev != NULL && frame_rings != NULL);
+  for (uint64_t i = ENTRIES_LENGTH; i < new_length; i += 1) {
+    entries[i]      = NULL;
+    histories[i]    = 0;
+    frame_blocks[i] = 0;
+    prefetched[i]   = false;
+    idle_ages[i]    = 0;
+    owners[i]       = 0;
+    hint_nodes[i]   = UINT8_MAX;
+    pins[i]         = 0;
+    frame_classes[i] = 0;
+  }
+  ENTRIES_LENGTH = new_length;
+
+} // resize_frame_table ()
 // =================================================================================================================================
 
 
 
 // =================================================================================================================================
-vmsim_addr_t
-vmsim_alloc (size_t size) {
+void
+vmsim_set_real_size (uint64_t size) {
 
   vmsim_init();
+  assert(size <= ((uint64_t)1 << 32) && bin_count == 1 && pinned_frames == 0);
+  uint64_t new_length = (size - PT_AREA_SIZE) / PAGESIZE;
+  uint64_t old_length = ENTRIES_LENGTH;
+  uint64_t slow_frames = ENTRIES_LENGTH - fast_frames;
+  assert(size > PT_AREA_SIZE && new_length > slow_frames);
 
-  // Pointer-bumping allocator with no reclamation.
-  vmsim_addr_t addr = sim_free_addr;
-  sim_free_addr += size;
-  return addr;
-  
-} // vmsim_alloc ()
+  // The slow tier, if any, keeps its size, so the fast tier absorbs the change.  Its used frames lie in [fast_frames, slow_used).
+  uint64_t new_fast  = new_length - slow_frames;
+  uint64_t slow_used = (slow_size != 0) ? get_page_no(slow_free_addr) : fast_frames;
+
+  if (new_length < old_length) {
+
+    // Shrinking:  evict the pages in the fast frames that are going away, then slide any slow-tier pages down to close the gap.
+    uint64_t fast_used = (real_free_addr < frame_addr(fast_frames)) ? get_page_no(real_free_addr) : fast_frames;
+    for (uint64_t i = new_fast; i < fast_used; i += 1) {
+      if (entries[i] != NULL) {
+        evict_frame(i);
+      }
+    }
+    for (uint64_t i = fast_frames; i < slow_used; i += 1) {
+      if (entries[i] != NULL) {
+        migrate_page(i, i - (fast_frames - new_fast));
+      }
+    }
+    if (real_free_addr > frame_addr(new_fast)) {
+      real_free_addr = frame_addr(new_fast);
+    }
+    cur_page_no %= new_fast;
+
+  }
+
+  // Remap the real storage space, moving it if need be, and follow it with the frame table.  No fill may be left pending on a frame
+  // that is about to move.
+  pg_flush();
+  void* old_base = real_base;
+  real_base = mremap(real_base, real_size, size, MREMAP_MAYMOVE);
+  assert(real_base != MAP_FAILED);
+  real_size  = size;
+  real_limit = (void*)((intptr_t)real_base + real_size);
+  resize_frame_table(new_length, old_base);
+
+  if (new_length > old_length) {
+
+    // Growing:  slide any slow-tier pages up, from the top down so that each destination is already free.
+    for (uint64_t i = slow_used; i > fast_frames; i -= 1) {
+      if (entries[i - 1] != NULL) {
+        migrate_page(i - 1, i - 1 + (new_fast - fast_frames));
+      }
+    }
+
+  }
+
+  if (slow_size != 0) {
+    slow_free_addr = frame_addr(new_fast + (slow_used - fast_frames));
+  }
+  fast_frames = new_fast;
+
+  // Pooled frames may have moved or gone, so pool the unowned frames below the bump pointers afresh.
+  uint64_t fast_end = (real_free_addr < frame_addr(fast_frames)) ? get_page_no(real_free_addr) : fast_frames;
+  uint64_t slow_end = (slow_size != 0) ? get_page_no(slow_free_addr) : fast_frames;
+  bin_counts[0]   = 0;
+  slow_pool_count = 0;
+  for (uint64_t i = 0; i < slow_end; i += 1) {
+    if (entries[i] == NULL && (i < fast_end || i >= fast_frames)) {
+      pool_frame(i);
+    }
+  }
+
+  // The frames have been renumbered across the tiers, so rebuild the rings of the classes.
+  rebuild_class_rings();
+
+} // vmsim_set_real_size ()
 // =================================================================================================================================
 
 
@@ -366,25 +4026,71 @@ vmsim_free (vmsim_addr_t ptr) {
 // =================================================================================================================================
 
 
-//Move_to_bs: takes a lower pte and moves its corresponding page to the backing store.
-//Replaces the address in the pte with a block number
+//Release_to_pager: takes a resident lower pte of a page that a pager covers, and hands the page back to the pager if it was
+//modified or came from the backing store.  Leaves the pte unmapped, so that the pager fills the page when it is next touched,
+//frees any block, and returns the real address of the newly freed memory.
+
+vmsim_addr_t
+release_to_pager(pt_entry_t* lpt_entry, int pager, vmsim_addr_t page){
+  pt_entry_t lpte_a = *lpt_entry;
+	vmsim_addr_t real_addr = GET_PAGE_ADDR(lpte_a);
+	void* real_ptr = (void*)(real_base + real_addr);
+	unsigned int block_no = frame_blocks[get_page_no(real_addr)];
+	if (block_no != 0 || IS_DIRTY(lpte_a)) {
+	  pg_writeback(pager, page, real_ptr);
+	} else {
+	  pg_discard();
+	}
+	if (block_no != 0) {
+	  wb_free(block_no);
+	}
+	frame_blocks[get_page_no(real_addr)] = 0;
+	class_unlink(get_page_no(real_addr));
+	spaces[owners[get_page_no(real_addr)]].stats.resident -= 1;
+	lpte_a = 0;
+	vmsim_write_real(&lpte_a, get_real_address(lpt_entry), sizeof(pt_entry_t));
+	pc_zero(real_ptr);
+	return real_addr;
+}
+
+//Move_to_bs: takes a lower pte and moves its corresponding page to the backing store, or to its pager if one covers it.
+//Replaces the address in the pte with a block number.  A clean page whose block still holds its data is not written again.
 //Returns the real address of the newly freed memory.
 
 vmsim_addr_t
 move_to_bs(pt_entry_t* lpt_entry){
   pt_entry_t lpte_a = *lpt_entry;
 	vmsim_addr_t real_addr = GET_PAGE_ADDR(lpte_a);
-	bs_write(real_addr, block_no);
+	unsigned int block_no = frame_blocks[get_page_no(real_addr)];
+	pg_complete_fill(real_base + real_addr);
+	invalidate_translation(get_page_no(real_addr));
+	vmsim_addr_t page = pte_page_addr(get_real_address(lpt_entry));
+	int pager = pg_find(owners[get_page_no(real_addr)], page);
+	if (pager != -1) {
+	  return release_to_pager(lpt_entry, pager, page);
+	}
+	if (block_no == 0 || IS_DIRTY(lpte_a)) {
+	  if (block_no == 0) {
+	    block_no = bs_alloc_block();
+	    assert(block_no != 0);
+	  }
+	  wb_write(real_addr, block_no);
+	}
+	frame_blocks[get_page_no(real_addr)] = 0;
+	class_unlink(get_page_no(real_addr));
+	spaces[owners[get_page_no(real_addr)]].stats.resident -= 1;
+	remember_eviction(get_real_address(lpt_entry));
 	int addr_remover = 0x3ff;
 	lpte_a &= addr_remover;
 	lpte_a |= (block_no << 10);
-	block_no = block_no + 1;
 	CLEAR_RESIDENT(lpte_a);
+	CLEAR_DIRTY(lpte_a);
+	CLEAR_ACTIVE(lpte_a);
 	vmsim_write_real(&lpte_a, get_real_address(lpt_entry), sizeof(pt_entry_t));
 
 	void* real_ptr = (void*)(real_base + real_addr);
 
-	memset(real_ptr, 0, PAGESIZE);
+	pc_zero(real_ptr);
 	return real_addr;
 }
 
@@ -396,37 +4102,71 @@ void
 move_to_mm(vmsim_addr_t lpt_entry_ra, vmsim_addr_t real_addr){
   pt_entry_t lpt_entry;
   vmsim_read_real(&lpt_entry, lpt_entry_ra, sizeof(pt_entry_t));
-	int blockno_getter = 0xfffc00;
-	int block_number = (lpt_entry & blockno_getter) >> 10;
-	bs_read(real_addr, block_number);
+	unsigned int blockno_getter = 0xfffffc00;
+	unsigned int block_number = (lpt_entry & blockno_getter) >> 10;
+	wb_read(real_addr, block_number);
+	install_page(lpt_entry_ra, real_addr, current_space);
+
+}
+
+//Install_page: takes a lower pte with a block number, a real address already holding the block's data, and the owning space
+//Assigns the real address to the pte and records the page in the frame table
+
+void
+install_page(vmsim_addr_t lpt_entry_ra, vmsim_addr_t real_addr, int space){
+  pt_entry_t lpt_entry;
+  vmsim_read_real(&lpt_entry, lpt_entry_ra, sizeof(pt_entry_t));
+	frame_blocks[get_page_no(real_addr)] = (lpt_entry & 0xfffffc00) >> 10;
 	lpt_entry &= 0x3ff;
 	lpt_entry |= real_addr;
 	SET_RESIDENT(lpt_entry);
 	vmsim_write_real (&lpt_entry, lpt_entry_ra, sizeof(pt_entry_t));
 
 	entries[get_page_no(real_addr)] = (pt_entry_t*)(real_base+lpt_entry_ra);
+	histories[get_page_no(real_addr)] = 0;
+	prefetched[get_page_no(real_addr)] = false;
+	idle_ages[get_page_no(real_addr)] = 0;
+	owners[get_page_no(real_addr)] = space;
+	hint_nodes[get_page_no(real_addr)] = UINT8_MAX;
+	frame_classes[get_page_no(real_addr)] = page_class(space, pte_page_addr(lpt_entry_ra));
+	class_link(get_page_no(real_addr));
+	spaces[space].stats.resident += 1;
 
 }
 
-//Swap: Combines the above to swap a given page out and copy a given block in
-void
-swap(vmsim_addr_t in, pt_entry_t* out){
-	vmsim_addr_t real_space = move_to_bs(out);
-	move_to_mm(in, real_space);
+//Search_range: CLOCK over the frames [first, first + count), with the hand kept relative to first.  Every visited frame has its
+//reference bit shifted into its history.  Returns the frame number of the first non-referenced entry, moving the hand past it so
+//that the page about to take its place is not the next one considered.
+uint64_t
+search_range(uint64_t* hand, uint64_t first, uint64_t count){
+  return search_stride(hand, first, count, 1);
 }
 
-//Search: Uses CLOCK algorithm to find a non-referenced lpt entry
-pt_entry_t* 
-search(){
-  vmsim_addr_t pt = PT_AREA_SIZE;
-  pt_entry_t lpte = *entries[cur_page_no];
-  while IS_REFERENCED(lpte){
-      pt_entry_t entry_no_ref = CLEAR_REFERENCED(lpte);
-      vmsim_write_real(&entry_no_ref, get_real_address(entries[cur_page_no]),sizeof(pt_entry_t));
-      cur_page_no = (cur_page_no + 1) % ENTRIES_LENGTH;
-      lpte = *entries[cur_page_no];
-    }
-  return entries[cur_page_no];
+//Search_stride: as search_range, but over the count frames first, first + stride, first + 2 * stride, and so on
+uint64_t
+search_stride(uint64_t* hand, uint64_t first, uint64_t count, uint64_t stride){
+  pt_entry_t* entry = entries[first + (*hand * stride)];
+  pt_entry_t  lpte  = (entry == NULL) ? 0 : *entry;
+  while (entry == NULL || pins[first + (*hand * stride)] > 0 || IS_REFERENCED(lpte) || IS_ACTIVE(lpte)){
+      //a pooled frame, which a promotion may have freed, holds no page and is passed over, as is a pinned page
+      //an active page that went a whole sweep unreferenced is deactivated rather than chosen
+      uint64_t frame = first + (*hand * stride);
+      if (entry != NULL && pins[frame] == 0) {
+        bool referenced = IS_REFERENCED(lpte);
+        histories[frame] = (histories[frame] >> 1) | (referenced ? 0x80 : 0);
+        resolve_prefetch(frame, referenced);
+        pt_entry_t entry_no_ref = referenced ? CLEAR_REFERENCED(lpte) : CLEAR_ACTIVE(lpte);
+        vmsim_write_real(&entry_no_ref, get_real_address(entries[frame]),sizeof(pt_entry_t));
+      }
+      *hand = (*hand + 1) % count;
+      entry = entries[first + (*hand * stride)];
+      lpte  = (entry == NULL) ? 0 : *entry;
+    }
+  uint64_t victim = first + (*hand * stride);
+  histories[victim] >>= 1;
+  resolve_prefetch(victim, false);
+  *hand = (*hand + 1) % count;
+  return victim;
 }
 
 uint64_t get_page_no(vmsim_addr_t real_addr){
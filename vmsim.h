@@ -26,6 +26,7 @@
 // =================================================================================================================================
 // INCLUDES
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 // =================================================================================================================================
@@ -40,6 +41,145 @@ typedef uint32_t vmsim_addr_t;
 
 /** A page table entry. */
 typedef uint32_t pt_entry_t;
+
+/** Counters describing the use of the fast and slow real memory tiers. */
+typedef struct {
+  uint64_t fast_accesses; /**< Accesses that hit a fast-tier frame. */
+  uint64_t slow_accesses; /**< Accesses that hit a slow-tier frame. */
+  uint64_t promotions;    /**< Pages moved from the slow tier to the fast tier. */
+  uint64_t demotions;     /**< Pages moved from the fast tier to the slow tier. */
+  uint64_t access_cost;   /**< The simulated cost of all accesses, in ns. */
+} vmsim_tier_stats_t;
+
+/** Counters describing page faults. */
+typedef struct {
+  uint64_t faults;       /**< Faults taken by the MMU. */
+  uint64_t first_touch;  /**< Faults that mapped a page for the first time. */
+  uint64_t swap_ins;     /**< Faults that swapped a page in from the backing store. */
+  uint64_t fault_around; /**< Neighbouring pages mapped ahead of their first touch. */
+} vmsim_fault_stats_t;
+
+/** Counters describing proactive reclaim. */
+typedef struct {
+  uint64_t passes;    /**< Batches of frames scanned. */
+  uint64_t scanned;   /**< Pages whose reference bits were harvested. */
+  uint64_t reclaimed; /**< Idle pages evicted ahead of need. */
+  uint64_t pool_hits; /**< Frames handed out from those freed by reclaim. */
+} vmsim_reclaim_stats_t;
+
+/** The number of buckets in the refault-distance histogram. */
+#define VMSIM_REFAULT_BUCKETS 24
+
+/**
+ * Counters describing refaults.  Bucket 0 of the histogram counts refaults at distance 0; bucket `k` counts those at distances in
+ * `[2^(k-1), 2^k)`, the last bucket taking every larger distance.
+ */
+typedef struct {
+  uint64_t refaults;    /**< Swap-ins of pages whose eviction was still remembered. */
+  uint64_t untracked;   /**< Swap-ins of pages whose eviction had been forgotten. */
+  uint64_t activations; /**< Refaulted pages activated. */
+  uint64_t histogram[VMSIM_REFAULT_BUCKETS]; /**< Refaults by distance, in evictions between the page's eviction and its refault. */
+} vmsim_refault_stats_t;
+
+/** The state and activity of one address space. */
+typedef struct {
+  int          priority;       /**< The space's priority; lower priorities are suspended first. */
+  bool         suspended;      /**< Whether the space is suspended, and so may not be switched to. */
+  uint64_t     resident;       /**< Frames holding the space's pages. */
+  uint64_t     accesses;       /**< Reads and writes made in the space. */
+  uint64_t     faults;         /**< Faults taken in the space. */
+  uint64_t     refaults;       /**< Swap-ins of pages evicted less than a real memory's worth of evictions earlier. */
+  uint64_t     suspensions;    /**< Times the space was suspended. */
+  uint64_t     resumes;        /**< Times the space was resumed. */
+  uint64_t     prepaged;       /**< Pages of the working set swapped back in on resumption. */
+  unsigned int pff;            /**< Faults per thousand accesses over the last load-control window. */
+  uint64_t     allotment;      /**< The fast-tier frames the space may hold under local replacement. */
+  uint64_t     self_evictions; /**< Pages displaced to make room for another page of the same space. */
+  uint64_t     frames_lost;    /**< Pages displaced to make room for a page of another space. */
+} vmsim_space_stats_t;
+
+/** The largest number of simulated NUMA nodes. */
+#define VMSIM_MAX_NODES 8
+
+/** Counters describing the simulated NUMA nodes. */
+typedef struct {
+  int      nodes;                                       /**< The number of nodes. */
+  uint64_t accesses[VMSIM_MAX_NODES][VMSIM_MAX_NODES];  /**< Fast-tier accesses, by the accessing thread's home node and then
+                                                             the node holding the frame. */
+  uint64_t access_cost[VMSIM_MAX_NODES];                /**< The simulated cost of those accesses, in ns, by home node. */
+  uint64_t local_accesses;                              /**< Accesses to frames on the accessing thread's home node. */
+  uint64_t remote_accesses;                             /**< Accesses to frames on other nodes. */
+  uint64_t allocations[VMSIM_MAX_NODES];                /**< Frames allocated on each node. */
+  uint64_t fallbacks;                                   /**< Allocations placed off the policy's node for lack of a free frame. */
+  uint64_t hint_faults;                                 /**< Accesses sampled by automatic balancing. */
+  uint64_t migrations;                                  /**< Pages moved by balancing to the node that accesses them. */
+  uint64_t failed_migrations;                           /**< Moves abandoned because that node had no free frame. */
+} vmsim_numa_stats_t;
+
+/** Counters describing frame compaction. */
+typedef struct {
+  uint64_t requests;         /**< Compactions asked for by contiguous prefaults and `vmsim_compact()`. */
+  uint64_t background;       /**< Compactions started by the background compactor. */
+  uint64_t runs;             /**< Free runs built, or found already free. */
+  uint64_t failures;         /**< Compactions that could not build their run. */
+  uint64_t migrations;       /**< Pages moved out of the way of a run. */
+  uint64_t evictions;        /**< Pages demoted or evicted out of the way of a run for lack of a free frame to move them to. */
+  uint64_t contiguous_pages; /**< Pages mapped into contiguous runs by `VMSIM_PREFAULT_CONTIGUOUS`. */
+  uint64_t largest_free_run; /**< The longest run of free fast-tier frames when the counters were copied. */
+} vmsim_compaction_stats_t;
+
+/** A handle on an asynchronous copy started by `vmsim_memcpy_async()`. */
+typedef int vmsim_copy_t;
+
+/** Counters describing asynchronous copies. */
+typedef struct {
+  uint64_t copies;       /**< Copies started. */
+  uint64_t completed;    /**< Copies whose completion has been reported. */
+  uint64_t bytes;        /**< Bytes handed to the copy engine. */
+  uint64_t chunks;       /**< Batches of pinned pages handed to the copy engine. */
+  uint64_t pinned_pages; /**< Pages pinned for those batches. */
+  uint64_t stalls;       /**< Times a copy could not go on because too many frames were already pinned. */
+  uint64_t waits;        /**< Times `vmsim_memcpy_wait()` had to block for the copy engine. */
+} vmsim_copy_stats_t;
+
+/**
+ * The callbacks of a pager, which supplies the pages of a range of simulated space, and takes them back when they leave real
+ * memory, in place of the backing store.  Each call carries a batch of pages, in the order they were queued.
+ */
+typedef struct {
+  /** Supply the data of `count` pages, each at the _simulated_ base address in `pages`, into the page-sized `buffers`. */
+  void  (*fill)      (void* context, const vmsim_addr_t* pages, void* const* buffers, size_t count);
+  /** Take the data of `count` modified pages leaving real memory.  If NULL, modifications are discarded. */
+  void  (*writeback) (void* context, const vmsim_addr_t* pages, const void* const* buffers, size_t count);
+  void* context;     /**< Passed to each callback. */
+} vmsim_pager_ops_t;
+
+/** Counters describing pagers. */
+typedef struct {
+  uint64_t pagers;            /**< Pagers registered. */
+  uint64_t fills;             /**< Pages supplied by pagers. */
+  uint64_t fill_batches;      /**< Calls to the fill callbacks. */
+  uint64_t writebacks;        /**< Modified pages handed back to pagers. */
+  uint64_t writeback_batches; /**< Calls to the writeback callbacks. */
+  uint64_t discards;          /**< Pages dropped from real memory without a writeback:  clean, or with no callback. */
+} vmsim_pager_stats_t;
+
+/** The number of QoS classes.  Pages of lower classes are displaced first. */
+#define VMSIM_QOS_CLASSES  4
+
+/** The QoS classes, from the first to be displaced to the last.  Untagged pages are `VMSIM_QOS_NORMAL`. */
+#define VMSIM_QOS_BULK     0
+#define VMSIM_QOS_NORMAL   1
+#define VMSIM_QOS_HIGH     2
+#define VMSIM_QOS_CRITICAL 3
+
+/** Counters describing QoS classes. */
+typedef struct {
+  uint64_t resident[VMSIM_QOS_CLASSES]; /**< Fast-tier frames holding pages of each class when the counters were copied. */
+  uint64_t victims[VMSIM_QOS_CLASSES];  /**< Pages of each class chosen to be evicted or demoted. */
+  uint64_t reserve_breaches;            /**< Victims taken from within their class's reserve, every class being within its own. */
+  uint64_t steps;                       /**< Frames visited by the classes' CLOCK hands in choosing those victims. */
+} vmsim_qos_stats_t;
 // =================================================================================================================================
 
 
@@ -50,6 +190,29 @@ typedef uint32_t pt_entry_t;
 #define PTE_RESIDENT_BIT   0x1
 #define PTE_REFERENCED_BIT 0x2
 #define PTE_DIRTY_BIT      0x4
+
+/** Set in place of the reference bit when the access monitor harvests it, so that page replacement still sees the reference. */
+#define PTE_YOUNG_BIT      0x8
+
+/** Set on a page that refaulted soon after its eviction, so that page replacement passes it over one extra time. */
+#define PTE_ACTIVE_BIT     0x10
+
+/** For `vmsim_alloc_flags()`:  establish mappings for the whole new block, as `vmsim_prefault()` does. */
+#define VMSIM_POPULATE     0x1
+
+/** For `vmsim_prefault()`:  map only as many pages as fit in unused frames, leaving the rest of the range unmapped. */
+#define VMSIM_PREFAULT_FIT 0x2
+
+/** For `vmsim_prefault()`:  map the range's unmapped pages into one run of contiguous fast-tier frames, compacting to make one. */
+#define VMSIM_PREFAULT_CONTIGUOUS 0x4
+
+/** For `vmsim_alloc_flags()`:  tag the new block with a QoS class, as `vmsim_set_class()` does. */
+#define VMSIM_ALLOC_CLASS(c) (((c) + 1) << 4)
+
+/** NUMA placement policies:  place each new page on the faulting thread's home node, on each node in turn, or on one given node. */
+#define VMSIM_NUMA_FIRST_TOUCH 0
+#define VMSIM_NUMA_INTERLEAVE  1
+#define VMSIM_NUMA_BIND        2
 // =================================================================================================================================
 
 
@@ -96,6 +259,15 @@ void         vmsim_read_real  (void* buffer, vmsim_addr_t real_addr, size_t size
  */
 void         vmsim_write_real (void* buffer, vmsim_addr_t real_addr, size_t size);
 
+/**
+ * \brief Copy a page out of the real space, bypassing the host's caches where possible.
+ * \param buffer A pointer to a page-sized space into which to copy the page.
+ * \param real_addr The real address of the page.
+ *
+ * This function is the analog to `vmsim_read_real()` for pages that are being written out, and will not be read again soon.
+ */
+void         vmsim_stream_real (void* buffer, vmsim_addr_t real_addr);
+
 /**
  * \brief Create a new simulated-to-real mapping for a simulated address.
  * \param sim_addr The simulated address for which to create the mapping.
@@ -109,11 +281,388 @@ void         vmsim_map_fault  (vmsim_addr_t sim_addr);
  */
 vmsim_addr_t vmsim_alloc      (size_t size);
 
+/**
+ * \brief  Allocate simulated memory space, with options.
+ * \param  size  The number of bytes to allocate.
+ * \param  flags `VMSIM_POPULATE` to map the block before returning, and `VMSIM_ALLOC_CLASS()` to tag it with a QoS class, before
+ *                it is populated; other flags are passed on to `vmsim_prefault()`.
+ * \return the simulated address of the a block that is at least `size` bytes in length.
+ */
+vmsim_addr_t vmsim_alloc_flags (size_t size, int flags);
+
+/**
+ * \brief  Establish mappings for a whole range of simulated space up front.
+ * \param  addr  The simulated address of the start of the range.
+ * \param  size  The number of bytes in the range.
+ * \param  flags 0, `VMSIM_PREFAULT_FIT` or `VMSIM_PREFAULT_CONTIGUOUS`.
+ * \return the number of pages newly mapped.
+ *
+ * Every lower page table the range needs is created first.  Unmapped pages are then backed by unused frames while any remain;
+ * the rest are given zero-filled backing-store blocks directly, allocated in address order and written in large batches, and are
+ * left non-resident.  Pages that are already mapped are untouched.  This keeps first-touch faults out of measured phases without
+ * cycling a range larger than real memory through the frames.  Pages that a pager covers are filled by it, and those that do not
+ * fit in unused frames are left unmapped.
+ *
+ * With `VMSIM_PREFAULT_CONTIGUOUS`, as for a large page or a direct segment, the unmapped pages are instead backed, in address
+ * order, by one run of contiguous frames on the placement policy's node.  If the node has no such free run, it is compacted at
+ * once, evicting pages if there are too few free frames to move them to.  A range with more unmapped pages than the node has frames
+ * is prefaulted as usual.
+ */
+size_t       vmsim_prefault   (vmsim_addr_t addr, size_t size, int flags);
+
+/**
+ * \brief  Copy data from host memory into a range of simulated space.
+ * \param  buffer The data to copy.
+ * \param  addr   The simulated address at which to place it.
+ * \param  size   The number of bytes to copy.
+ *
+ * Unlike `vmsim_write()`, the range may span many pages and need not fit in real memory.  Resident pages are written in place and
+ * non-resident pages are written straight to their backing-store blocks, in batches.  Unmapped pages take unused frames while any
+ * remain; the rest are given new blocks and left non-resident, so that loading a data set larger than real memory does not evict
+ * each page it has just written.
+ */
+void         vmsim_import     (const void* buffer, vmsim_addr_t addr, size_t size);
+
+/**
+ * \brief  Copy a range of simulated space out to host memory.
+ * \param  buffer A space into which to copy the data.
+ * \param  addr   The simulated address of the range.
+ * \param  size   The number of bytes to copy.
+ *
+ * Pages are read from their frames or backing-store blocks without being faulted in, so exporting leaves real memory as it was.
+ * Unmapped pages read as zeros.
+ */
+void         vmsim_export     (void* buffer, vmsim_addr_t addr, size_t size);
+
+/**
+ * \brief  Copy data from a file descriptor into a range of simulated space, as `vmsim_import()` does.
+ * \param  fd   The descriptor from which to read.
+ * \param  addr The simulated address at which to place the data.
+ * \param  size The most bytes to copy.
+ * \return the number of bytes copied, which is less than `size` at end of file or on a read error.
+ */
+size_t       vmsim_import_fd  (int fd, vmsim_addr_t addr, size_t size);
+
+/**
+ * \brief  Copy a range of simulated space to a file descriptor, as `vmsim_export()` does.
+ * \param  fd   The descriptor to which to write.
+ * \param  addr The simulated address of the range.
+ * \param  size The number of bytes to copy.
+ * \return the number of bytes copied, which is less than `size` only on a write error.
+ */
+size_t       vmsim_export_fd  (int fd, vmsim_addr_t addr, size_t size);
+
+/**
+ * \brief  Grow or shrink real memory while the simulation runs, as a balloon driver or an elastic container would.
+ * \param  size The new number of bytes of real memory, as for `VMSIM_REAL_MEM_SIZE`.
+ *
+ * Growing remaps real memory and enlarges the frame table; the new frames are filled before anything else is evicted.  Shrinking
+ * first evicts the pages held in the frames that are going away.  When real memory is tiered, the slow tier keeps its size and the
+ * fast tier takes up the change, so `size` must leave at least one fast frame.
+ */
+void         vmsim_set_real_size (uint64_t size);
+
 /**
  * \brief Deallocate simulated memory space.
  * \param ptr The simulated address of a memory block allocated with `vmsim_alloc`.
  */
 void         vmsim_free       (vmsim_addr_t ptr);
+
+/**
+ * \brief Report the activity of the real memory tiers.
+ * \param stats A space into which to copy the current counters.
+ *
+ * Real memory is split into a fast tier and a slow tier when `VMSIM_SLOW_MEM_SIZE` gives the number of bytes, at the top of real
+ * memory, that are slow.  The per-access costs are set by `VMSIM_FAST_MEM_LATENCY` and `VMSIM_SLOW_MEM_LATENCY`.  New and
+ * swapped-in pages are placed in the fast tier; cold fast pages are demoted to the slow tier, and only slow pages are evicted to
+ * the backing store.  Slow pages referenced on consecutive CLOCK samples are promoted.  Without a slow tier, every access counts
+ * as fast.
+ */
+void         vmsim_get_tier_stats (vmsim_tier_stats_t* stats);
+
+/**
+ * \brief Report page fault activity.
+ * \param stats A space into which to copy the current counters.
+ *
+ * Setting `VMSIM_FAULT_AROUND` to a number of pages makes a first-touch fault inside the allocated space also map the untouched
+ * pages of the aligned window of that many pages around it, within the same lower page table, so that populating fresh memory
+ * takes a fraction of the faults.
+ */
+void         vmsim_get_fault_stats (vmsim_fault_stats_t* stats);
+
+/**
+ * \brief Report the activity of proactive reclaim.
+ * \param stats A space into which to copy the current counters.
+ *
+ * When `VMSIM_RECLAIM_INTERVAL` is set, every that many accesses the reclaimer harvests the reference bits of the next
+ * `VMSIM_RECLAIM_BATCH` pages that could be evicted (the slow tier's pages, when real memory is tiered).  A page that stays
+ * unreferenced for `VMSIM_RECLAIM_AGE` consecutive passes is written back and evicted even though real memory is not full, and its
+ * frame is kept for the next fault, which then needs no synchronous replacement.
+ */
+void         vmsim_get_reclaim_stats (vmsim_reclaim_stats_t* stats);
+
+/**
+ * \brief Report the refault distances of swapped-in pages.
+ * \param stats A space into which to copy the current counters.
+ *
+ * Each eviction stamps the page's shadow entry, in a bounded side table, with the running count of evictions.  When a fault swaps
+ * the page back in, the difference is its refault distance:  the number of other pages evicted while it was out.  A page whose
+ * distance is within the number of frames would have survived in a memory holding only its working set, so this distinguishes a
+ * working set that is shifting (long distances) from one that does not fit (short distances).  When `VMSIM_REFAULT_ACTIVATE` is
+ * set, a page refaulting at such a short distance is activated:  CLOCK passes it over once when it is found unreferenced, instead
+ * of choosing it at once.
+ */
+void         vmsim_get_refault_stats (vmsim_refault_stats_t* stats);
+
+/**
+ * \brief  Create a new address space, with its own page tables and allocator.
+ * \param  priority The space's priority under load control; lower priorities are suspended first.
+ * \return the number of the new space.  Space 0, with priority 0, exists from the start and is current until another is switched
+ *         to.
+ *
+ * The spaces share real memory and the backing store.  Their page tables share the region of real memory reserved for page tables,
+ * so each space takes at least one page of it.
+ */
+int          vmsim_space_create  (int priority);
+
+/**
+ * \brief  Make an address space current, so that later allocations and accesses are made in it.
+ * \param  space The space to switch to.
+ * \return whether the switch was made, which it is not if the space is suspended.
+ */
+bool         vmsim_space_switch  (int space);
+
+/**
+ * \brief  Report the current address space.
+ * \return the number of the current space.
+ */
+int          vmsim_space_current ();
+
+/**
+ * \brief  Suspend an address space, evicting its pages and refusing switches to it until it is resumed.
+ * \param  space The space to suspend, which must not be the current one.
+ */
+void         vmsim_space_suspend (int space);
+
+/**
+ * \brief  Resume a suspended address space.
+ * \param  space The space to resume.
+ *
+ * The pages that the space had referenced recently when it was suspended form its working set.  Unless `VMSIM_PREPAGE` is 0, they
+ * are swapped back in at once, sorted into backing-store order and read in vectored batches, instead of faulting back one by one.
+ */
+void         vmsim_space_resume  (int space);
+
+/**
+ * \brief Report the state and activity of an address space.
+ * \param space The space.
+ * \param stats A space into which to copy the current counters.
+ *
+ * Every `VMSIM_LOAD_WINDOW` accesses, each space's page-fault frequency is computed and the refaults of all spaces are totalled.
+ * When `VMSIM_LOAD_CONTROL` is set and there are at least `VMSIM_THRASH_THRESHOLD` refaults per thousand accesses, the system is
+ * taken to be thrashing:  the lowest-priority running space, other than the current one, is suspended, and its frames go to the
+ * rest.  At `VMSIM_RESUME_THRESHOLD` or fewer, the highest-priority space suspended for at least `VMSIM_MIN_SUSPENSION` windows
+ * is resumed.  A caller that schedules several spaces should skip those whose switch is refused.
+ *
+ * `VMSIM_REPLACEMENT` chooses the scope of replacement.  Under `global`, the default, a fault may displace any space's page, so a
+ * space's share of real memory follows its demand.  Under `local`, each space holds at most its allotment of fast-tier frames:  a
+ * space at its allotment displaces one of its own pages, and one below it takes a free frame, or else a page of a space above its
+ * own allotment.  A thrashing space then cannot take frames from the others.  A new space is allotted an equal share of the fast
+ * tier, and `vmsim_space_set_allotment()` sets an allotment directly.  When `VMSIM_PFF_CONTROL` is set, the allotments follow the
+ * page-fault frequencies instead.  At the end of each window, each running space that made accesses in it is adjusted.  One
+ * faulting fewer than `VMSIM_PFF_LOWER` (5) times per thousand accesses gives up `VMSIM_PFF_STEP` (8) frames, but keeps
+ * `VMSIM_PFF_MIN` (8) and as many as it referenced over the window.  Then one faulting more than `VMSIM_PFF_UPPER` (20) times gains
+ * as many:  first those that no space is allotted, then those beyond the referenced frames of spaces faulting less often, and,
+ * while it holds less than an equal share of the fast tier, those beyond an equal share of any other.  Local replacement applies
+ * only with a single bin of frames, without NUMA nodes or page coloring.
+ */
+void         vmsim_get_space_stats (int space, vmsim_space_stats_t* stats);
+
+/**
+ * \brief  Set the allotment of an address space, for local replacement.
+ * \param  space  The space.
+ * \param  frames The number of fast-tier frames that the space may hold, no more than there are.
+ *
+ * A space above its new allotment keeps its pages until they are displaced, first by the faults of spaces below their allotments.
+ * The allotment is adjusted by the page-fault-frequency controller if it is enabled.
+ */
+void         vmsim_space_set_allotment (int space, uint64_t frames);
+
+/**
+ * \brief  Move pages from one address space to another without copying their data.
+ * \param  src_space The space that gives up the pages.
+ * \param  src_addr  The page-aligned _simulated_ address of the first page to move.
+ * \param  dst_space The space that receives the pages, which may be the same space.
+ * \param  dst_addr  The page-aligned _simulated_ address at which to place the first page.
+ * \param  npages    The number of pages to move.
+ * \return the number of pages moved:  those that were mapped in the source range.
+ *
+ * Only the page table entries and the frame table change hands.  A resident page keeps its frame and a swapped-out page its
+ * backing-store block, so handing a buffer to another space costs nothing per byte.  The source range is left unmapped, and reads
+ * there as zeros.  Whatever was mapped in the destination range is discarded first, so an unmapped source page leaves its
+ * destination page unmapped too.  The destination range must have been allocated in its space by `vmsim_alloc()`.  Neither space
+ * may be suspended, and within one space the ranges may not overlap.
+ */
+size_t       vmsim_move_pages      (int src_space, vmsim_addr_t src_addr, int dst_space, vmsim_addr_t dst_addr, size_t npages);
+
+/**
+ * \brief Set the home node of the calling thread, from which its accesses are made and near which first-touch places its pages.
+ * \param node The node, below the `VMSIM_NUMA_NODES` nodes configured.  Every thread starts on node 0.
+ */
+void         vmsim_numa_set_home   (int node);
+
+/**
+ * \brief Set the placement policy for new pages.
+ * \param policy One of `VMSIM_NUMA_FIRST_TOUCH` (the default), `VMSIM_NUMA_INTERLEAVE` or `VMSIM_NUMA_BIND`.
+ * \param node   For `VMSIM_NUMA_BIND`, the node to which pages are bound; otherwise ignored.
+ *
+ * The policy starts as `VMSIM_NUMA_POLICY` (`first-touch`, `interleave` or `bind`), binding to `VMSIM_NUMA_BIND_NODE`.  A node with
+ * no free frame passes first-touch and interleaved pages to the nearest node that has one; bound pages instead evict within their
+ * node.
+ */
+void         vmsim_numa_set_policy (int policy, int node);
+
+/**
+ * \brief  Report the number of page colors.
+ * \return the number of colors, 1 unless `VMSIM_PAGE_COLORING` is set.
+ *
+ * A frame's color is its real page number modulo the number of colors, which is `VMSIM_PAGE_COLORS` or else the number of
+ * page-sized slices in one way of the cache model's last-level cache (128 without the model), rounded down to a power of two no
+ * greater than 1024.  `VMSIM_PAGE_COLORING` set to `space` gives each new page the next color, round-robin, from its space's range;
+ * set to `virtual`, it gives the color matching the page's virtual page number.  Each page then takes a free frame of its color, or
+ * displaces the coldest page of that color, so that pages of different colors never compete for the same cache sets.
+ */
+int          vmsim_page_colors     ();
+
+/**
+ * \brief Restrict the pages of an address space to a range of colors, partitioning the last-level cache between spaces.
+ * \param space The space, which starts with every color.
+ * \param first The first color of the range.
+ * \param count The number of colors in the range.
+ */
+void         vmsim_space_set_colors (int space, int first, int count);
+
+/**
+ * \brief Report how many frames of each color hold pages.
+ * \param space     The space whose pages to count, or -1 for every space.
+ * \param occupancy A space of `vmsim_page_colors()` counters into which to write the counts.
+ */
+void         vmsim_get_color_occupancy (int space, uint64_t* occupancy);
+
+/**
+ * \brief Report the activity of the simulated NUMA nodes.
+ * \param stats A space into which to copy the current counters.
+ *
+ * `VMSIM_NUMA_NODES` (default 1) splits the fast tier evenly into nodes.  An access costs the fast-tier latency scaled by the
+ * distance from the thread's home node to the frame's node, in tenths:  `VMSIM_NUMA_DISTANCES` lists the row-major matrix of
+ * distances, comma-separated, defaulting to 10 within a node and 20 between nodes.  When `VMSIM_NUMA_BALANCE` is set, every
+ * `VMSIM_NUMA_BALANCE_INTERVAL`th access is sampled as a hinting fault, and a page sampled twice in a row from the same remote node
+ * is moved to that node if it has a free frame.
+ */
+void         vmsim_get_numa_stats  (vmsim_numa_stats_t* stats);
+
+/**
+ * \brief  Compact the fast tier of the placement policy's node until it has a run of free frames of the given length.
+ * \param  pages The length of the run, in frames.
+ * \return whether such a run is now free.
+ *
+ * The run is built where the fewest pages are in the way, and those pages are moved into free frames elsewhere on the node.  If
+ * there are too few free frames for them, nothing is moved.
+ */
+bool         vmsim_compact         (size_t pages);
+
+/**
+ * \brief Report the activity of frame compaction.
+ * \param stats A space into which to copy the current counters.
+ *
+ * Once pages are freed and reused piecemeal, free frames are scattered, and nothing that needs contiguous frames can be placed.
+ * When `VMSIM_COMPACT_INTERVAL` is set, every that many accesses the background compactor checks each node in turn, and if the node
+ * has at least `VMSIM_COMPACT_PAGES` (default 64) free frames but no run of that many, compacts it to build one.
+ */
+void         vmsim_get_compaction_stats (vmsim_compaction_stats_t* stats);
+
+/**
+ * \brief  Start copying a range of simulated space to another in the background, as a DMA engine would.
+ * \param  dst  The _simulated_ address to which to copy, in the current space.
+ * \param  src  The _simulated_ address from which to copy, in the current space.
+ * \param  len  The number of bytes to copy.  The ranges may not overlap.
+ * \return a handle with which to wait for the copy.
+ *
+ * The copy proceeds in chunks.  The pages of each chunk are faulted in as needed and pinned, so that nothing evicts or moves them,
+ * and a helper thread then copies them frame to frame while the caller goes on making accesses.  The next chunk is started when
+ * the caller next makes an access, or asks after the copy, and finds the last one done.  Until the copy is complete, the caller
+ * should not touch either range, nor suspend the space.  At most 64 copies may be in progress, and a fraction of the frames may be
+ * pinned at once.
+ */
+vmsim_copy_t vmsim_memcpy_async    (vmsim_addr_t dst, vmsim_addr_t src, size_t len);
+
+/**
+ * \brief  Report whether an asynchronous copy is complete, advancing it if it is not.
+ * \param  copy The copy's handle, which is released, and may not be used again, once this function returns `true`.
+ * \return whether the copy is complete.
+ */
+bool         vmsim_memcpy_test     (vmsim_copy_t copy);
+
+/**
+ * \brief  Wait for an asynchronous copy to complete, and release its handle.
+ * \param  copy The copy's handle.
+ */
+void         vmsim_memcpy_wait     (vmsim_copy_t copy);
+
+/**
+ * \brief Report the activity of asynchronous copies.
+ * \param stats A space into which to copy the current counters.
+ */
+void         vmsim_get_copy_stats  (vmsim_copy_stats_t* stats);
+
+/**
+ * \brief  Have a pager supply the pages of a range of the current space.
+ * \param  addr The _simulated_ address of the range, which must be page-aligned.
+ * \param  size The length of the range, in bytes, which must be a whole number of pages.
+ * \param  ops  The pager's callbacks, which are copied.
+ * \return the pager's number.
+ *
+ * A page of the range that is touched while unmapped is filled by the pager rather than zeroed, and a page of the range that is
+ * evicted is handed back to the pager if it was modified, and simply dropped if not, rather than going to the backing store; it
+ * is then unmapped again, and is filled afresh when next touched.  Pages the range already holds are handed over as they are
+ * evicted.  Fills and writebacks are queued and delivered in batches:  at the end of each fault, prefault, import or export, and
+ * whenever `VMSIM_PAGER_BATCH` (default 16) have gathered.  A writeback is always delivered before any later fill of the same page.
+ * At most 16 pagers may be registered, and the ranges of one space may not overlap.
+ */
+int          vmsim_register_pager  (vmsim_addr_t addr, size_t size, const vmsim_pager_ops_t* ops);
+
+/**
+ * \brief Report the activity of pagers.
+ * \param stats A space into which to copy the current counters.
+ */
+void         vmsim_get_pager_stats (vmsim_pager_stats_t* stats);
+
+/**
+ * \brief  Tag a range of the current space with a QoS class, which decides the order in which its pages are displaced.
+ * \param  addr      The _simulated_ address of the range.
+ * \param  size      The length of the range, in bytes.  Every page that the range touches is tagged.
+ * \param  qos_class The class, from `VMSIM_QOS_BULK` to `VMSIM_QOS_CRITICAL`.
+ *
+ * A later tag overrides an earlier one where the two overlap, and applies at once to the range's resident pages.  Once any range
+ * is tagged, a page to be evicted or demoted from the fast tier is chosen by CLOCK over the frames of a single class:  the lowest
+ * class holding more frames than its reserve, or, if every class is within its reserve, the lowest holding any.  Each class keeps
+ * its frames in a ring with its own hand, so the choice never passes over the frames of other classes.  With NUMA nodes or page
+ * coloring, whose frames are chosen within a node or color, the classes are ignored.
+ */
+void         vmsim_set_class       (vmsim_addr_t addr, size_t size, int qos_class);
+
+/**
+ * \brief  Reserve fast-tier frames for a QoS class, which lower classes must give up before it gives up any.
+ * \param  qos_class The class.
+ * \param  pages     The number of frames that the class keeps while any class holds more than its own reserve (0 by default).
+ */
+void         vmsim_set_class_reserve (int qos_class, size_t pages);
+
+/**
+ * \brief Report the activity of QoS classes.
+ * \param stats A space into which to copy the current counters.
+ */
+void         vmsim_get_qos_stats   (vmsim_qos_stats_t* stats);
 // =================================================================================================================================
 
 
@@ -0,0 +1,269 @@
+// =================================================================================================================================
+/**
+ * wb.c
+ *
+ * Buffer evicted pages on their way to the backing store, and write them out in sorted batches.
+ **/
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bs.h"
+#include "pagecopy.h"
+#include "wb.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// CONSTANTS AND MACRO FUNCTIONS
+
+#define PAGESIZE         4096
+#define DEFAULT_PAGES    0
+#define DEFAULT_MAX_AGE  1024
+
+// One buffered page:  the block it belongs to and the write count at which it entered the buffer.
+typedef struct {
+  unsigned int block_number;
+  uint64_t     stamp;
+} wb_entry_t;
+
+static unsigned int capacity  = DEFAULT_PAGES;
+static uint64_t     max_age   = DEFAULT_MAX_AGE;
+static bool         ready     = false;
+static wb_entry_t*  slots     = NULL;
+static uint8_t*     data      = NULL;
+static unsigned int count     = 0;
+static wb_stats_t   stats;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+void
+wb_init () {
+
+  // Only initialize if it hasn't already happened.
+  if (!ready) {
+
+    char* pages_envvar = getenv("VMSIM_WB_PAGES");
+    if (pages_envvar != NULL) {
+      capacity = strtoul(pages_envvar, NULL, 10);
+    }
+    char* age_envvar = getenv("VMSIM_WB_MAX_AGE");
+    if (age_envvar != NULL) {
+      max_age = strtoull(age_envvar, NULL, 10);
+    }
+    if (capacity > 0) {
+      slots = malloc(sizeof(wb_entry_t) * capacity);
+      int aligned = posix_memalign((void**)&data, PAGESIZE, (size_t)capacity * PAGESIZE);
+      assert(slots != NULL && aligned == 0);
+    }
+    ready = true;
+
+  }
+
+}
+
+
+
+/**
+ * \return the slot holding the given block, or `capacity` if it is not buffered.
+ */
+unsigned int
+find_slot (unsigned int block_number) {
+
+  for (unsigned int i = 0; i < count; i += 1) {
+    if (slots[i].block_number == block_number) {
+      return i;
+    }
+  }
+  return capacity;
+
+}
+
+
+
+/**
+ * Drop a slot, moving the last slot into its place.
+ */
+void
+remove_slot (unsigned int slot) {
+
+  count -= 1;
+  if (slot != count) {
+    slots[slot] = slots[count];
+    pc_stream(data + ((size_t)slot * PAGESIZE), data + ((size_t)count * PAGESIZE));
+  }
+
+}
+
+
+
+int
+compare_slots (const void* a, const void* b) {
+
+  unsigned int block_a = slots[*(const unsigned int*)a].block_number;
+  unsigned int block_b = slots[*(const unsigned int*)b].block_number;
+  return (block_a > block_b) - (block_a < block_b);
+
+}
+
+
+
+void
+wb_flush () {
+
+  if (count == 0) {
+    return;
+  }
+
+  // Issue the pages in block order, so that neighbouring blocks can be coalesced into single device operations.
+  unsigned int order[count];
+  unsigned int block_numbers[count];
+  const void*  pages[count];
+  for (unsigned int i = 0; i < count; i += 1) {
+    order[i] = i;
+  }
+  qsort(order, count, sizeof(unsigned int), compare_slots);
+  for (unsigned int i = 0; i < count; i += 1) {
+    block_numbers[i] = slots[order[i]].block_number;
+    pages[i]         = data + ((size_t)order[i] * PAGESIZE);
+  }
+  bool success = bs_write_batch(pages, block_numbers, count);
+  assert(success);
+
+  stats.flushes       += 1;
+  stats.flushed_pages += count;
+  count                = 0;
+
+} // wb_flush ()
+
+
+
+bool
+wb_write (vmsim_addr_t buffer, unsigned int block_number) {
+
+  wb_init();
+  if (capacity == 0) {
+    return bs_write(buffer, block_number);
+  }
+
+  // A newer copy of a waiting page simply replaces it.
+  stats.writes += 1;
+  unsigned int slot = find_slot(block_number);
+  if (slot != capacity) {
+    stats.overwrites += 1;
+  } else {
+    slot                     = count++;
+    slots[slot].block_number = block_number;
+    slots[slot].stamp        = stats.writes;
+  }
+  vmsim_stream_real(data + ((size_t)slot * PAGESIZE), buffer);
+
+  // Flush when full, or when the oldest page has waited long enough.  Slots are only ever appended, except for removals that move
+  // the last slot forward, so the oldest stamp is found by a scan.
+  bool flush = (count == capacity);
+  for (unsigned int i = 0; !flush && i < count; i += 1) {
+    flush = (stats.writes - slots[i].stamp >= max_age);
+  }
+  if (flush) {
+    wb_flush();
+  }
+  return true;
+
+} // wb_write ()
+
+
+
+bool
+wb_read (vmsim_addr_t buffer, unsigned int block_number) {
+
+  wb_init();
+  unsigned int slot = (capacity == 0) ? capacity : find_slot(block_number);
+  if (slot == capacity) {
+    return bs_read(buffer, block_number);
+  }
+
+  // The page stays buffered, since its block must still receive the data.
+  vmsim_write_real(data + ((size_t)slot * PAGESIZE), buffer, PAGESIZE);
+  stats.hits += 1;
+  return true;
+
+} // wb_read ()
+
+
+
+bool
+wb_read_batch (void* const* pages, const unsigned int* block_numbers, size_t count) {
+
+  wb_init();
+  if (capacity == 0) {
+    return bs_read_batch(pages, block_numbers, count);
+  }
+
+  // Serve what is buffered, and read the rest as one batch.
+  void*        misses[count];
+  unsigned int miss_blocks[count];
+  size_t       miss_count = 0;
+  for (size_t i = 0; i < count; i += 1) {
+    unsigned int slot = find_slot(block_numbers[i]);
+    if (slot != capacity) {
+      pc_copy(pages[i], data + ((size_t)slot * PAGESIZE));
+      stats.hits += 1;
+    } else {
+      misses[miss_count]      = pages[i];
+      miss_blocks[miss_count] = block_numbers[i];
+      miss_count             += 1;
+    }
+  }
+  return (miss_count == 0) || bs_read_batch(misses, miss_blocks, miss_count);
+
+} // wb_read_batch ()
+
+
+
+bool
+wb_write_batch (const void* const* pages, const unsigned int* block_numbers, size_t count) {
+
+  wb_init();
+
+  // The new data supersedes anything still waiting for these blocks.
+  for (size_t i = 0; capacity != 0 && i < count; i += 1) {
+    unsigned int slot = find_slot(block_numbers[i]);
+    if (slot != capacity) {
+      remove_slot(slot);
+    }
+  }
+  return bs_write_batch(pages, block_numbers, count);
+
+} // wb_write_batch ()
+
+
+
+void
+wb_free (unsigned int block_number) {
+
+  wb_init();
+  unsigned int slot = (capacity == 0) ? capacity : find_slot(block_number);
+  if (slot != capacity) {
+    remove_slot(slot);
+  }
+  bs_free_block(block_number);
+
+} // wb_free ()
+
+
+
+void
+wb_get_stats (wb_stats_t* copy) {
+
+  *copy = stats;
+
+} // wb_get_stats ()
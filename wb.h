@@ -0,0 +1,114 @@
+// =================================================================================================================================
+/**
+ * \file   wb.h
+ * \brief  The interface for the write-back buffer that sits in front of the backing store.
+ *
+ * Evicted pages are copied into a bounded buffer, so that their frames can be reused at once, and reach the backing store later in
+ * batches sorted by block number.  A buffered page that is faulted back in is served from the buffer.  The buffer holds
+ * `VMSIM_WB_PAGES` pages (0, the default, disables it) and flushes when full, or once its oldest page has waited for
+ * `VMSIM_WB_MAX_AGE` further buffered writes.
+ */
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// Avoid multiple inclusion.
+
+#if !defined (_WB_H)
+#define _WB_H
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// INCLUDES
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vmsim.h"
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// TYPES
+
+/** Counters describing the write-back buffer. */
+typedef struct {
+  uint64_t writes;        /**< Pages written into the buffer. */
+  uint64_t overwrites;    /**< Writes that replaced a page still waiting in the buffer. */
+  uint64_t hits;          /**< Reads served from the buffer. */
+  uint64_t flushes;       /**< Batches written to the backing store. */
+  uint64_t flushed_pages; /**< Pages written to the backing store by those batches. */
+} wb_stats_t;
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+// FUNCTIONS
+
+/**
+ * \brief  Initialize the write-back buffer, reading its configuration from the environment.
+ */
+void wb_init  ();
+
+/**
+ * \brief  Buffer a page destined for a block of the backing store.
+ * \param  buffer       The _real_ address of the page's data.
+ * \param  block_number The block to which the page belongs.
+ * \return whether the operation was successful.
+ */
+bool wb_write (vmsim_addr_t buffer, unsigned int block_number);
+
+/**
+ * \brief  Read a block, from the buffer if it is still waiting there, otherwise from the backing store.
+ * \param  buffer       The _real_ address of a space into which to copy the block's data.
+ * \param  block_number The block to read.
+ * \return whether the operation was successful.
+ */
+bool wb_read  (vmsim_addr_t buffer, unsigned int block_number);
+
+/**
+ * \brief  Read a batch of blocks into host memory, from the buffer where possible and otherwise from the backing store.
+ * \param  pages         Pointers to the spaces into which to copy each block's data.
+ * \param  block_numbers The blocks to read.
+ * \param  count         The number of blocks in the batch.
+ * \return whether every read was successful.
+ */
+bool wb_read_batch  (void* const* pages, const unsigned int* block_numbers, size_t count);
+
+/**
+ * \brief  Write a batch of blocks from host memory straight to the backing store, discarding any older buffered copies.
+ * \param  pages         Pointers to the data of each block.
+ * \param  block_numbers The blocks to write.
+ * \param  count         The number of blocks in the batch.
+ * \return whether every write was successful.
+ */
+bool wb_write_batch (const void* const* pages, const unsigned int* block_numbers, size_t count);
+
+/**
+ * \brief  Release a block, discarding any buffered data for it.
+ * \param  block_number The block to release.
+ */
+void wb_free  (unsigned int block_number);
+
+/**
+ * \brief  Write every buffered page to the backing store.
+ */
+void wb_flush ();
+
+/**
+ * \brief  Report the activity of the write-back buffer.
+ * \param  stats A space into which to copy the counters.
+ */
+void wb_get_stats (wb_stats_t* stats);
+// =================================================================================================================================
+
+
+
+// =================================================================================================================================
+#endif // _WB_H
+// =================================================================================================================================